@@ -0,0 +1,128 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares TimerWheel with the binary heap TaskRunner used before it. N
+// tasks due within the next 100ms are filed, then drained by stepping time
+// 1ms at a time, the way the platform thread wakes up for them. Prints the
+// cost per task of each phase.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "timer_wheel.h"
+
+namespace {
+
+constexpr uint64_t kBaseTime = 1000000000000ull;
+constexpr uint64_t kSpread = 100000000ull;
+constexpr uint64_t kStep = 1000000ull;
+
+using QueuedTask = std::pair<uint64_t, FlutterTask>;
+
+class CompareQueuedTask {
+ public:
+  bool operator()(const QueuedTask& a, const QueuedTask& b) const {
+    return a.first > b.first;
+  }
+};
+
+using TaskHeap = std::priority_queue<QueuedTask,
+                                     std::vector<QueuedTask>,
+                                     CompareQueuedTask>;
+
+using Clock = std::chrono::steady_clock;
+
+double NanosecondsPerTask(Clock::time_point start, size_t count) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+             .count() /
+         count;
+}
+
+// Sums the task ids so the drain loops cannot be optimized away.
+uint64_t BenchHeap(const std::vector<uint64_t>& targets,
+                   double* push_ns,
+                   double* pop_ns) {
+  uint64_t checksum = 0;
+  TaskHeap heap;
+
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < targets.size(); i++) {
+    heap.push(QueuedTask(targets[i], FlutterTask{nullptr, i}));
+  }
+  *push_ns = NanosecondsPerTask(start, targets.size());
+
+  start = Clock::now();
+  for (uint64_t now = kBaseTime; !heap.empty(); now += kStep) {
+    while (!heap.empty() && heap.top().first <= now) {
+      checksum += heap.top().second.task;
+      heap.pop();
+    }
+  }
+  *pop_ns = NanosecondsPerTask(start, targets.size());
+  return checksum;
+}
+
+uint64_t BenchWheel(const std::vector<uint64_t>& targets,
+                    double* insert_ns,
+                    double* expire_ns) {
+  uint64_t checksum = 0;
+  flutter::TimerWheel wheel;
+  wheel.Advance(kBaseTime);
+
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < targets.size(); i++) {
+    wheel.Insert(FlutterTask{nullptr, i}, targets[i]);
+  }
+  *insert_ns = NanosecondsPerTask(start, targets.size());
+
+  start = Clock::now();
+  FlutterTask task;
+  for (uint64_t now = kBaseTime; wheel.size() != 0; now += kStep) {
+    while (wheel.PopExpired(now, &task, nullptr)) {
+      checksum += task.task;
+    }
+  }
+  *expire_ns = NanosecondsPerTask(start, targets.size());
+  return checksum;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const size_t counts[] = {10000, 100000, 1000000};
+
+  printf("%8s  %10s %10s | %12s %12s\n", "tasks", "heap push", "heap pop",
+         "wheel insert", "wheel expire");
+  for (size_t count : counts) {
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> targets(count);
+    for (uint64_t& target : targets) {
+      target = kBaseTime + random() % kSpread;
+    }
+
+    double push_ns, pop_ns, insert_ns, expire_ns;
+    uint64_t heap_sum = BenchHeap(targets, &push_ns, &pop_ns);
+    uint64_t wheel_sum = BenchWheel(targets, &insert_ns, &expire_ns);
+    if (heap_sum != wheel_sum) {
+      fprintf(stderr, "Heap and wheel ran different tasks\n");
+      return EXIT_FAILURE;
+    }
+
+    printf("%8zu  %7.1f ns %7.1f ns | %9.1f ns %9.1f ns\n", count, push_ns,
+           pop_ns, insert_ns, expire_ns);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "backing_store_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace flutter {
+
+BackingStorePool::BackingStorePool(size_t budget_bytes,
+                                   CreateFunction create,
+                                   DeleteFunction destroy)
+    : budget_bytes_(budget_bytes),
+      create_(std::move(create)),
+      destroy_(std::move(destroy)) {}
+
+BackingStorePool::~BackingStorePool() {
+  for (PooledBackingStore* store : free_) {
+    delete store;
+  }
+}
+
+PooledBackingStore* BackingStorePool::Acquire(size_t width,
+                                              size_t height,
+                                              uint32_t format) {
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    PooledBackingStore* store = *it;
+    if (store->width == width && store->height == height &&
+        store->format == format) {
+      free_.erase(it);
+      hits_++;
+      return store;
+    }
+  }
+
+  misses_++;
+  PooledBackingStore* store = new PooledBackingStore();
+  store->width = width;
+  store->height = height;
+  store->format = format;
+  if (!create_(store)) {
+    delete store;
+    return nullptr;
+  }
+  resident_bytes_ += store->bytes();
+  peak_resident_bytes_ = std::max(peak_resident_bytes_, resident_bytes_);
+  // Make room among the free stores for the new one.
+  Evict();
+  return store;
+}
+
+void BackingStorePool::Release(PooledBackingStore* store) {
+  free_.push_front(store);
+  Evict();
+}
+
+void BackingStorePool::Evict() {
+  while (resident_bytes_ > budget_bytes_ && !free_.empty()) {
+    PooledBackingStore* store = free_.back();
+    free_.pop_back();
+    resident_bytes_ -= store->bytes();
+    evictions_++;
+    destroy_(*store);
+    delete store;
+  }
+}
+
+void BackingStorePool::PrintSummary(FILE* out) const {
+  fprintf(out,
+          "  backing stores: %llu hits, %llu misses, %llu evicted; %zu KiB "
+          "resident, %zu KiB at peak, %zu KiB budget, %zu free\n",
+          (unsigned long long)hits_, (unsigned long long)misses_,
+          (unsigned long long)evictions_, resident_bytes_ / 1024,
+          peak_resident_bytes_ / 1024, budget_bytes_ / 1024, free_.size());
+}
+
+}  // namespace flutter
@@ -0,0 +1,86 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_BACKING_STORE_POOL_H_
+#define EMBEDDER_FLUTTER_BACKING_STORE_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <functional>
+#include <list>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A framebuffer with a texture attached, as LayerCompositor hands them to
+// the engine.
+struct PooledBackingStore {
+  uint32_t framebuffer = 0;
+  uint32_t texture = 0;
+  size_t width = 0;
+  size_t height = 0;
+  uint32_t format = 0;
+
+  size_t bytes() const { return width * height * 4; }
+};
+
+// Reuses backing stores across frames, driver allocations are slow on Mali
+// and Vivante. Released stores wait in a free list for a request of the
+// same size and format. Once everything resident, in use or free, exceeds
+// the budget the least recently released free stores are deleted; stores
+// in use are never evicted, so a transition briefly needing more layers
+// goes over the budget instead of failing. Needs the render context
+// current, not thread safe.
+class BackingStorePool {
+ public:
+  // Fills in the GL objects for the store's size and format.
+  using CreateFunction = std::function<bool(PooledBackingStore*)>;
+  using DeleteFunction = std::function<void(const PooledBackingStore&)>;
+
+  BackingStorePool(size_t budget_bytes,
+                   CreateFunction create,
+                   DeleteFunction destroy);
+
+  // Free stores are left to the context, which may not be current.
+  ~BackingStorePool();
+
+  // A free store of that size and format, or a new one. Null if creating
+  // one failed.
+  PooledBackingStore* Acquire(size_t width, size_t height, uint32_t format);
+
+  void Release(PooledBackingStore* store);
+
+  // One line with the counters.
+  void PrintSummary(FILE* out) const;
+
+ private:
+  size_t budget_bytes_;
+  CreateFunction create_;
+  DeleteFunction destroy_;
+
+  // Most recently released first. Short, the budget holds a few screens.
+  std::list<PooledBackingStore*> free_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+  size_t resident_bytes_ = 0;
+  size_t peak_resident_bytes_ = 0;
+
+  void Evict();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(BackingStorePool);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_BACKING_STORE_POOL_H_
@@ -0,0 +1,109 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_EMBEDDER_OPTIONS_H_
+#define EMBEDDER_FLUTTER_EMBEDDER_OPTIONS_H_
+
+#include <stdint.h>
+
+namespace flutter {
+
+// Which threads serve the engine's raster task runner. The UI and IO runners
+// are always created by the engine.
+enum class ThreadTopology {
+  // Raster tasks are merged onto the platform thread.
+  kPlatform,
+  // The engine spawns its own raster thread.
+  kEngine,
+  // The embedder owns the raster thread and can pin it.
+  kRaster,
+};
+
+// Tunables of the embedder itself, filled in from the command line.
+struct EmbedderOptions {
+  // Longest time the platform thread spends running due engine tasks before
+  // it goes back to the wayland socket. Zero means no limit.
+  uint64_t task_budget_us = 8000;
+
+  ThreadTopology thread_topology = ThreadTopology::kEngine;
+  // CPU the embedder owned raster thread is pinned to, -1 for none.
+  int raster_cpu = -1;
+
+  // Read wl_seat, wl_touch and wl_keyboard events on a dedicated thread.
+  bool input_thread = false;
+
+  // Seconds between platform task statistics lines, zero for none. A full
+  // dump is printed on SIGUSR1 either way.
+  uint32_t stats_interval_s = 0;
+
+  // How long the platform thread may stay busy before the watchdog logs a
+  // stall with a backtrace, zero to disable it.
+  uint32_t watchdog_ms = 2000;
+
+  // Drive the engine's frames from wl_surface.frame callbacks instead of
+  // its own timer.
+  bool vsync = true;
+
+  // A frame callback outstanding for longer than this means the compositor
+  // stopped showing the surface. Zero relies on enter/leave alone.
+  uint32_t hidden_timeout_ms = 1000;
+
+  // Frame rate cap, rounded down to the display's rate divided by a whole
+  // number. Zero is the display's native rate.
+  uint32_t max_fps = 0;
+  // Cap in force once |idle_after_frames| frames were rendered without user
+  // input, until the next input event. Zero |idle_after_frames| disables it.
+  uint32_t idle_fps = 10;
+  uint32_t idle_after_frames = 0;
+
+  // Share of the screen size the engine renders at, the compositor scales
+  // the result up through wp_viewporter.
+  double render_scale = 1.0;
+  // Non zero lets the scale float between this and |render_scale| depending
+  // on how long frames take to raster.
+  double min_render_scale = 0;
+
+  // Let the engine repaint only what changed, using EGL buffer age and swap
+  // with damage where the driver has them.
+  bool partial_repaint = true;
+
+  // The app draws with transparency. The surface then starts without an
+  // opaque region and the app sets it, and the input region, through the
+  // flutter_embedder/display channel.
+  bool translucent = false;
+
+  // Vblanks eglSwapBuffers waits for. Zero keeps the raster thread from
+  // blocking in the driver, frames are then throttled by the frame
+  // callbacks vsync waits for.
+  int swap_interval = 1;
+  // Swap on a dedicated thread, so the raster thread can go on with the
+  // next frame's work while the swap waits. Needs EGL_KHR_fence_sync and
+  // EGL_KHR_surfaceless_context.
+  bool swap_thread = false;
+  // Ask the compositor for async flips through wp_tearing_control_v1 and
+  // swap with interval 0. Lower latency, frames may tear. Needs vsync, and
+  // can be toggled through the flutter_embedder/display channel.
+  bool tearing = false;
+
+  // Give the engine a FlutterCompositor and show its layers in subsurfaces
+  // instead of rendering everything into the window. Needs wl_subcompositor
+  // and a render scale of 1.
+  bool compositor = false;
+  // Backing stores the compositor keeps for reuse, in and out of use, may
+  // take up this much before free ones are deleted.
+  uint32_t backing_store_budget_mb = 64;
+
+  // Hold vsync while the GPU has more than this many frames queued, zero
+  // to let the driver queue grow.
+  uint32_t gpu_max_frames_behind = 2;
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_EMBEDDER_OPTIONS_H_
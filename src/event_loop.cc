@@ -0,0 +1,177 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "event_loop.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace flutter {
+
+static constexpr int kMaxEventsPerPoll = 16;
+static constexpr uint64_t kNanosecondsPerSecond = 1000000000ull;
+
+EventLoop::EventLoop() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    FLWAY_ERR << "Could not create epoll instance: " << strerror(errno)
+              << std::endl;
+    return;
+  }
+
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0) {
+    FLWAY_ERR << "Could not create timerfd: " << strerror(errno) << std::endl;
+    return;
+  }
+
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    FLWAY_ERR << "Could not create eventfd: " << strerror(errno) << std::endl;
+    return;
+  }
+
+  const int internal_fds[] = {timer_fd_, wakeup_fd_};
+  for (int fd : internal_fds) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      FLWAY_ERR << "Could not watch internal fd: " << strerror(errno)
+                << std::endl;
+      return;
+    }
+  }
+
+  valid_ = true;
+}
+
+EventLoop::~EventLoop() {
+  if (wakeup_fd_ >= 0) {
+    close(wakeup_fd_);
+  }
+  if (timer_fd_ >= 0) {
+    close(timer_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    close(epoll_fd_);
+  }
+}
+
+bool EventLoop::IsValid() const {
+  return valid_;
+}
+
+bool EventLoop::AddFd(int fd, uint32_t events, Callback callback) {
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+    FLWAY_ERR << "Could not add fd " << fd << " to the event loop: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  callbacks_[fd] = std::move(callback);
+  return true;
+}
+
+void EventLoop::RemoveFd(int fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  callbacks_.erase(fd);
+}
+
+bool EventLoop::ModifyFd(int fd, uint32_t events) {
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) != 0) {
+    FLWAY_ERR << "Could not modify fd " << fd << " in the event loop: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void EventLoop::SetDeadline(uint64_t deadline) {
+  if (deadline == armed_deadline_) {
+    return;
+  }
+
+  struct itimerspec spec = {};
+  if (deadline != 0) {
+    // it_value of zero disarms the timer, so clamp already expired deadlines
+    // to the smallest valid absolute time instead.
+    spec.it_value.tv_sec = deadline / kNanosecondsPerSecond;
+    spec.it_value.tv_nsec = deadline % kNanosecondsPerSecond;
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      spec.it_value.tv_nsec = 1;
+    }
+  }
+
+  if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+    LOG_ERROR(stderr, "Could not arm the loop timer: %s\n", strerror(errno));
+    return;
+  }
+  armed_deadline_ = deadline;
+}
+
+void EventLoop::Wakeup() {
+  uint64_t value = 1;
+  // EAGAIN only happens when the counter is saturated, in which case the loop
+  // is going to wake up anyway.
+  if (write(wakeup_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+    LOG_ERROR(stderr, "Could not wake up the event loop: %s\n",
+              strerror(errno));
+  }
+}
+
+int EventLoop::Poll(int timeout_ms) {
+  struct epoll_event events[kMaxEventsPerPoll];
+
+  int count = epoll_wait(epoll_fd_, events, kMaxEventsPerPoll, timeout_ms);
+  if (count < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    FLWAY_ERR << "epoll_wait failed: " << strerror(errno) << std::endl;
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const int fd = events[i].data.fd;
+    uint64_t value;
+
+    if (fd == timer_fd_) {
+      // The timer is one shot; the owner re-arms it for the next deadline.
+      read(timer_fd_, &value, sizeof(value));
+      armed_deadline_ = 0;
+      continue;
+    }
+
+    if (fd == wakeup_fd_) {
+      read(wakeup_fd_, &value, sizeof(value));
+      continue;
+    }
+
+    auto callback = callbacks_.find(fd);
+    if (callback != callbacks_.end()) {
+      callback->second(events[i].events);
+    }
+  }
+
+  return count;
+}
+
+}  // namespace flutter
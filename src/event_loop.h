@@ -0,0 +1,71 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_EVENT_LOOP_H_
+#define EMBEDDER_FLUTTER_EVENT_LOOP_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A single threaded epoll reactor. Besides the file descriptors registered by
+// the owner, the loop owns a timerfd armed to the earliest pending deadline and
+// an eventfd that other threads use to wake it up.
+//
+// Deadlines are absolute CLOCK_MONOTONIC nanoseconds, which is the clock
+// FlutterEngineGetCurrentTime() reports.
+class EventLoop {
+ public:
+  using Callback = std::function<void(uint32_t events)>;
+
+  EventLoop();
+
+  ~EventLoop();
+
+  bool IsValid() const;
+
+  // Not thread safe. Must be called on the thread that runs the loop.
+  bool AddFd(int fd, uint32_t events, Callback callback);
+
+  void RemoveFd(int fd);
+
+  // Changes the events |fd| is watched for.
+  bool ModifyFd(int fd, uint32_t events);
+
+  // Arms the timer for |deadline|. Zero disarms it. Deadlines already in the
+  // past fire immediately.
+  void SetDeadline(uint64_t deadline);
+
+  // Thread safe. Forces the current or next Poll() to return.
+  void Wakeup();
+
+  // Waits up to |timeout_ms| (-1 for ever) for any registered descriptor, the
+  // timer or a wakeup and dispatches the callbacks of the ready descriptors.
+  // Returns the number of ready descriptors, or -1 on error.
+  int Poll(int timeout_ms);
+
+ private:
+  bool valid_ = false;
+  int epoll_fd_ = -1;
+  int timer_fd_ = -1;
+  int wakeup_fd_ = -1;
+  uint64_t armed_deadline_ = 0;
+  std::map<int, Callback> callbacks_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(EventLoop);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_EVENT_LOOP_H_
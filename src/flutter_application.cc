@@ -22,6 +22,7 @@
 #include "log.h"
 #include "utils.h"
 #include "input_hook.h"
+#include "thread_checker.h"
 
 namespace flutter {
 
@@ -61,7 +62,8 @@ static std::string GetICUDataPath() {
 FlutterApplication::FlutterApplication(
     std::string bundle_path,
     //const std::vector<std::string>& command_line_args,
-    RenderDelegate& render_delegate)
+    RenderDelegate& render_delegate,
+    const EmbedderOptions& options)
     : render_delegate_(render_delegate) {
   if (!FlutterAssetBundleIsValid(bundle_path)) {
     FLWAY_ERR << "Flutter asset bundle was not valid." << std::endl;
@@ -88,11 +90,28 @@ FlutterApplication::FlutterApplication(
   };
   FLWAY_LOG << "register OnApplicationContextClearCurrent() " << std::endl;
 
-  config.open_gl.present = [](void* userdata) -> bool {
-    return reinterpret_cast<FlutterApplication*>(userdata)
-        ->render_delegate_.OnApplicationPresent();
-  };
-  FLWAY_LOG << "register OnApplicationPresent() " << std::endl;
+  if (options.partial_repaint) {
+    // The engine prefers present_with_info and only repaints what changed
+    // plus what the back buffer is missing.
+    config.open_gl.present_with_info =
+        [](void* userdata, const FlutterPresentInfo* info) -> bool {
+      return reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationPresentWithInfo(info);
+    };
+    config.open_gl.populate_existing_damage =
+        [](void* userdata, const intptr_t fbo_id, FlutterDamage* damage) {
+          reinterpret_cast<FlutterApplication*>(userdata)
+              ->render_delegate_.OnApplicationPopulateExistingDamage(fbo_id,
+                                                                     damage);
+        };
+    FLWAY_LOG << "register OnApplicationPresentWithInfo() " << std::endl;
+  } else {
+    config.open_gl.present = [](void* userdata) -> bool {
+      return reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationPresent();
+    };
+    FLWAY_LOG << "register OnApplicationPresent() " << std::endl;
+  }
 
   config.open_gl.fbo_callback = [](void* userdata) -> uint32_t {
     return reinterpret_cast<FlutterApplication*>(userdata)
@@ -159,16 +178,53 @@ FlutterApplication::FlutterApplication(
   //platform channel callback
   project_args.platform_message_callback = [](const FlutterPlatformMessage* message,
                                       void* context) {
-    reinterpret_cast<FlutterApplication*>(context)
-        ->platform_channel_.PlatformMessageCallback(message);
+    auto application = reinterpret_cast<FlutterApplication*>(context);
+    if (ThreadChecker::assertions_enabled() &&
+        !application->render_delegate_.OnApplicationRunsTasksOnCurrentThread()) {
+      FLWAY_ERR << "Platform message on " << message->channel
+                << " delivered off the platform thread." << std::endl;
+      abort();
+    }
+    // Handlers run in the plugin lane, behind input, frames and engine tasks.
+    // The engine only keeps the message alive for the duration of this
+    // callback, the response handle stays valid until it is answered.
+    std::string channel = message->channel;
+    std::vector<uint8_t> data(message->message,
+                              message->message + message->message_size);
+    const FlutterPlatformMessageResponseHandle* response_handle =
+        message->response_handle;
+    const char* label =
+        application->channel_names_.insert(channel).first->c_str();
+    application->render_delegate_.OnApplicationPostWork(
+        WorkLane::kPlugin, label,
+        [application, channel, data, response_handle]() {
+          FlutterPlatformMessage deferred = {};
+          deferred.struct_size = sizeof(FlutterPlatformMessage);
+          deferred.channel = channel.c_str();
+          deferred.message = data.data();
+          deferred.message_size = data.size();
+          deferred.response_handle = response_handle;
+          application->platform_channel_.PlatformMessageCallback(&deferred);
+        });
   };
 
+  if (options.vsync) {
+    project_args.vsync_callback = [](void* userdata, intptr_t baton) {
+      reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationVsync(baton);
+    };
+  }
+
   // Configure task runner interop
   FlutterTaskRunnerDescription platform_task_runner = {};
   platform_task_runner.struct_size = sizeof(FlutterTaskRunnerDescription);
   platform_task_runner.user_data = this;
+  platform_task_runner.identifier = 1;
   platform_task_runner.runs_task_on_current_thread_callback =
-      [](void* context) -> bool { return true; };
+      [](void* context) -> bool {
+    return reinterpret_cast<FlutterApplication*>(context)
+        ->render_delegate_.OnApplicationRunsTasksOnCurrentThread();
+  };
   platform_task_runner.post_task_callback =
       [](FlutterTask task, uint64_t target_time, void* context) -> void {
     reinterpret_cast<FlutterApplication*>(context)
@@ -178,7 +234,72 @@ FlutterApplication::FlutterApplication(
   FlutterCustomTaskRunners custom_task_runners = {};
   custom_task_runners.struct_size = sizeof(FlutterCustomTaskRunners);
   custom_task_runners.platform_task_runner = &platform_task_runner;
+
+  FlutterTaskRunnerDescription render_task_runner = {};
+  switch (options.thread_topology) {
+    case ThreadTopology::kPlatform:
+      FLWAY_LOG << "Raster tasks run on the platform thread" << std::endl;
+      custom_task_runners.render_task_runner = &platform_task_runner;
+      break;
+
+    case ThreadTopology::kRaster:
+      render_thread_.reset(new TaskRunnerThread(
+          "flutter.raster", options.raster_cpu,
+          [](const FlutterTask* task) { FlutterRunTask(task); }));
+      if (!render_thread_->IsValid()) {
+        FLWAY_ERR << "Could not start the raster thread." << std::endl;
+        return;
+      }
+      render_task_runner.struct_size = sizeof(FlutterTaskRunnerDescription);
+      render_task_runner.user_data = render_thread_.get();
+      render_task_runner.identifier = 2;
+      render_task_runner.runs_task_on_current_thread_callback =
+          [](void* context) -> bool {
+        return reinterpret_cast<TaskRunnerThread*>(context)
+            ->RunsTasksOnCurrentThread();
+      };
+      render_task_runner.post_task_callback =
+          [](FlutterTask task, uint64_t target_time, void* context) -> void {
+        reinterpret_cast<TaskRunnerThread*>(context)->PostTask(task,
+                                                               target_time);
+      };
+      custom_task_runners.render_task_runner = &render_task_runner;
+      break;
+
+    case ThreadTopology::kEngine:
+      break;
+  }
   project_args.custom_task_runners = &custom_task_runners;
+
+  if (options.compositor) {
+    // The engine renders layers into backing stores and hands them over
+    // instead of presenting the onscreen surface.
+    compositor_.struct_size = sizeof(FlutterCompositor);
+    compositor_.user_data = this;
+    compositor_.create_backing_store_callback =
+        [](const FlutterBackingStoreConfig* config,
+           FlutterBackingStore* backing_store, void* userdata) -> bool {
+      return reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationCreateBackingStore(config,
+                                                             backing_store);
+    };
+    compositor_.collect_backing_store_callback =
+        [](const FlutterBackingStore* backing_store, void* userdata) -> bool {
+      return reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationCollectBackingStore(backing_store);
+    };
+    compositor_.present_layers_callback = [](const FlutterLayer** layers,
+                                             size_t layers_count,
+                                             void* userdata) -> bool {
+      return reinterpret_cast<FlutterApplication*>(userdata)
+          ->render_delegate_.OnApplicationPresentLayers(layers, layers_count);
+    };
+    // Every frame's stores come back, LayerCompositor pools them itself by
+    // size and format.
+    compositor_.avoid_backing_store_cache = true;
+    project_args.compositor = &compositor_;
+    FLWAY_LOG << "register FlutterCompositor" << std::endl;
+  }
   
   FLWAY_LOG << "Prepare to run flutter engine..." << std::endl;
 
@@ -206,6 +327,10 @@ FlutterApplication::~FlutterApplication() {
   if (result != kSuccess) {
     FLWAY_ERR << "Could not shutdown the Flutter engine." << std::endl;
   }
+
+  // The engine waits for raster tasks during shutdown, so the raster thread
+  // has to outlive it.
+  render_thread_.reset();
 }
 
 bool FlutterApplication::IsValid() const {
@@ -213,16 +338,29 @@ bool FlutterApplication::IsValid() const {
 }
 
 bool FlutterApplication::SetWindowSize(size_t width, size_t height) {
-  LOG_INFO("Set windows metrics event: (%d,%d) on engine:0x%lx\n", width, height, engine_);
+  return SendWindowMetrics(width, height, 1.0);
+}
+
+bool FlutterApplication::SendWindowMetrics(size_t width,
+                                           size_t height,
+                                           double pixel_ratio) {
+  LOG_INFO("Set windows metrics event: (%d,%d) x%.2f on engine:0x%lx\n", width,
+           height, pixel_ratio, engine_);
 
   FlutterWindowMetricsEvent event = {};
   event.struct_size = sizeof(event);
   event.width = width;
   event.height = height;
-  event.pixel_ratio = 1.0;
+  event.pixel_ratio = pixel_ratio;
   return FlutterEngineSendWindowMetricsEvent(engine_, &event) == kSuccess;
 }
 
+void FlutterApplication::SetPlatformMessageHandler(
+    const std::string& channel,
+    PlatformChannel::MessageHandler handler) {
+  platform_channel_.SetMessageHandler(channel, std::move(handler));
+}
+
 FlutterEngineResult FlutterApplication::SendInputEventToFlutter(FlutterPointerEvent* inputEvents,
                                             int count) {
   FlutterEngineResult result = kInternalInconsistency;
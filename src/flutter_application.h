@@ -11,12 +11,18 @@
 #define EMBEDDER_FLUTTER_APPLICATION_H_
 
 #include <functional>
+#include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 #include <flutter_embedder.h>
 
+#include "embedder_options.h"
 #include "macros.h"
 #include "platform_channel.h"
+#include "task_runner_thread.h"
+#include "work_queue.h"
 
 namespace flutter {
 
@@ -29,17 +35,45 @@ class FlutterApplication {
     virtual bool OnApplicationContextClearCurrent() = 0;
 
     virtual bool OnApplicationPresent() = 0;
+    // Present with the region that changed, for partial repaint.
+    virtual bool OnApplicationPresentWithInfo(const FlutterPresentInfo* info) = 0;
+    // Fills in what the back buffer is missing compared to the last frame.
+    virtual void OnApplicationPopulateExistingDamage(intptr_t fbo_id,
+                                                     FlutterDamage* damage) = 0;
 
     virtual uint32_t OnApplicationGetOnscreenFBO() = 0;
 
+    // FlutterCompositor, with EmbedderOptions::compositor.
+    virtual bool OnApplicationCreateBackingStore(
+        const FlutterBackingStoreConfig* config,
+        FlutterBackingStore* backing_store) = 0;
+    virtual bool OnApplicationCollectBackingStore(
+        const FlutterBackingStore* backing_store) = 0;
+    virtual bool OnApplicationPresentLayers(const FlutterLayer** layers,
+                                            size_t layers_count) = 0;
+
     virtual bool OnApplicationMakeResourceCurrent() = 0;
 
     virtual void OnApplicationGetTaskrunner(FlutterTask task, uint64_t target_time) = 0;
+
+    virtual bool OnApplicationRunsTasksOnCurrentThread() = 0;
+
+    // Thread safe. Queues |work| on the platform thread in |lane|, which is
+    // WorkLane::kFrame or WorkLane::kPlugin. |label| names it in stall
+    // reports and has to outlive the delegate.
+    virtual void OnApplicationPostWork(WorkLane lane,
+                                       const char* label,
+                                       std::function<void()> work) = 0;
+
+    // Called on the UI thread. The engine wants to start a frame; |baton|
+    // goes back through FlutterEngineOnVsync.
+    virtual void OnApplicationVsync(intptr_t baton) = 0;
   };
 
   FlutterApplication(std::string bundle_path,
                     //  const std::vector<std::string>& args,
-                     RenderDelegate& render_delegate);
+                     RenderDelegate& render_delegate,
+                     const EmbedderOptions& options);
 
   ~FlutterApplication();
 
@@ -47,6 +81,15 @@ class FlutterApplication {
 
   bool SetWindowSize(size_t width, size_t height);
 
+  // |width| and |height| are physical pixels, |pixel_ratio| physical pixels
+  // per logical pixel.
+  static bool SendWindowMetrics(size_t width, size_t height, double pixel_ratio);
+
+  // Handles |channel| in the embedder. Handlers run in the plugin lane of the
+  // platform thread.
+  void SetPlatformMessageHandler(const std::string& channel,
+                                 PlatformChannel::MessageHandler handler);
+
   static FlutterEngineResult SendInputEventToFlutter(FlutterPointerEvent* inputEvents,int count);
   static FlutterEngineResult FlutterSendMessage(const char *channel, const uint8_t *message, const size_t message_size);
   static FlutterEngineResult FlutterRunTask(const FlutterTask* task);
@@ -56,6 +99,11 @@ class FlutterApplication {
   RenderDelegate& render_delegate_;
   int last_button_ = 0;
   PlatformChannel platform_channel_;
+  FlutterCompositor compositor_ = {};
+  std::unique_ptr<TaskRunnerThread> render_thread_;
+  // Every channel a message arrived on, so work can be labelled with a name
+  // that stays valid. Platform thread only.
+  std::set<std::string> channel_names_;
   static FlutterEngine engine_;  
   
   bool SendFlutterPointerEvent(FlutterPointerPhase phase, double x, double y);
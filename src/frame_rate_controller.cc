@@ -0,0 +1,74 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_rate_controller.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+FrameRateController::FrameRateController(uint32_t max_fps,
+                                         uint32_t idle_fps,
+                                         uint32_t idle_after_frames)
+    : max_fps_(max_fps),
+      idle_fps_(idle_fps),
+      idle_after_frames_(idle_after_frames) {}
+
+void FrameRateController::SetMaxFrameRate(uint32_t fps) {
+  max_fps_ = fps;
+}
+
+void FrameRateController::SetIdleFrameRate(uint32_t fps,
+                                           uint32_t idle_after_frames) {
+  idle_fps_ = fps;
+  idle_after_frames_ = idle_after_frames;
+  frames_since_input_ = 0;
+  idle_ = false;
+}
+
+bool FrameRateController::OnFrame() {
+  frames_since_input_++;
+  if (idle_ || idle_after_frames_ == 0 || idle_fps_ == 0 ||
+      frames_since_input_ < idle_after_frames_) {
+    return false;
+  }
+  idle_ = true;
+  return true;
+}
+
+bool FrameRateController::OnInput() {
+  frames_since_input_ = 0;
+  if (!idle_) {
+    return false;
+  }
+  idle_ = false;
+  return true;
+}
+
+uint32_t FrameRateController::frame_rate() const {
+  if (!idle_) {
+    return max_fps_;
+  }
+  return max_fps_ != 0 ? std::min(max_fps_, idle_fps_) : idle_fps_;
+}
+
+uint64_t FrameRateController::FrameInterval(uint64_t vsync_interval) const {
+  const uint32_t fps = frame_rate();
+  if (fps == 0 || vsync_interval == 0) {
+    return vsync_interval;
+  }
+  // Round up to a whole number of vblanks, a cap must not be exceeded. The
+  // 1% slack keeps 60 fps on a 59.94 Hz panel at every vblank.
+  const uint64_t wanted = 1000000000ull / fps * 99 / 100;
+  const uint64_t vblanks = std::max<uint64_t>(
+      1, (wanted + vsync_interval - 1) / vsync_interval);
+  return vblanks * vsync_interval;
+}
+
+}  // namespace flutter
@@ -0,0 +1,69 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_FRAME_RATE_CONTROLLER_H_
+#define EMBEDDER_FLUTTER_FRAME_RATE_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Decides how many vblanks apart frames are started. The cap is a whole
+// number of display refreshes, so a 30 fps cap on a 60 Hz panel shows every
+// frame for exactly two vblanks instead of alternating one and three.
+//
+// In the automatic mode the cap drops to the idle rate once
+// |idle_after_frames| frames were rendered without user input, and returns
+// to the regular one on the next input event. Not thread safe.
+class FrameRateController {
+ public:
+  FrameRateController(uint32_t max_fps,
+                      uint32_t idle_fps,
+                      uint32_t idle_after_frames);
+
+  // Zero means the display's native rate.
+  void SetMaxFrameRate(uint32_t fps);
+
+  // Zero |idle_after_frames| turns the automatic mode off.
+  void SetIdleFrameRate(uint32_t fps, uint32_t idle_after_frames);
+
+  // A frame reached the screen. Returns true if that made the controller
+  // enter idle.
+  bool OnFrame();
+
+  // Returns true if the controller left idle.
+  bool OnInput();
+
+  // The cap in force right now, zero for native.
+  uint32_t frame_rate() const;
+
+  // Minimum time between the target vblanks of two frames on a display
+  // refreshing every |vsync_interval| nanoseconds.
+  uint64_t FrameInterval(uint64_t vsync_interval) const;
+
+  uint32_t max_fps() const { return max_fps_; }
+  uint32_t idle_fps() const { return idle_fps_; }
+  uint32_t idle_after_frames() const { return idle_after_frames_; }
+  bool idle() const { return idle_; }
+
+ private:
+  uint32_t max_fps_;
+  uint32_t idle_fps_;
+  uint32_t idle_after_frames_;
+  uint64_t frames_since_input_ = 0;
+  bool idle_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameRateController);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_FRAME_RATE_CONTROLLER_H_
@@ -0,0 +1,113 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace flutter {
+
+constexpr size_t FrameStats::kWindow;
+
+FrameStats::FrameStats() = default;
+
+FrameStats::Verdict FrameStats::Record(const FrameTiming& timing,
+                                       uint64_t target,
+                                       uint64_t interval) {
+  frames_++;
+
+  const uint64_t start =
+      timing.vsync_start != 0 ? timing.vsync_start : timing.present;
+  if (timing.frame_done > start) {
+    window_[window_next_] = timing.frame_done - start;
+    window_next_ = (window_next_ + 1) % kWindow;
+    window_size_ = std::min(window_size_ + 1, kWindow);
+  }
+  if (timing.present > start) {
+    render_time_.Record(timing.present - start);
+  }
+  if (timing.swap_done > timing.present) {
+    swap_time_.Record(timing.swap_done - timing.present);
+  }
+  if (timing.gpu_done > timing.present) {
+    gpu_time_.Record(timing.gpu_done - timing.present);
+  }
+  if (timing.input != 0 && timing.frame_done > timing.input) {
+    (timing.tearing ? input_latency_tearing_ : input_latency_)
+        .Record(timing.frame_done - timing.input);
+  }
+
+  // The frame callback follows the vblank the frame made, give it half an
+  // interval of slack.
+  Verdict verdict = Verdict::kOnTime;
+  if (interval != 0 && timing.frame_done > target + interval / 2) {
+    const uint64_t vblanks_late =
+        (timing.frame_done - target + interval / 2) / interval;
+    verdict = vblanks_late >= 2 ? Verdict::kDropped : Verdict::kLate;
+  }
+
+  switch (verdict) {
+    case Verdict::kOnTime:
+      on_time_++;
+      streak_ = 0;
+      break;
+    case Verdict::kLate:
+    case Verdict::kDropped:
+      if (verdict == Verdict::kLate) {
+        late_++;
+      } else {
+        dropped_++;
+      }
+      streak_++;
+      if (streak_ == 2) {
+        streaks_++;
+      }
+      longest_streak_ = std::max(longest_streak_, streak_);
+      break;
+  }
+  return verdict;
+}
+
+void FrameStats::RecordGpuRenderTime(uint64_t gpu_time) {
+  gpu_render_time_.Record(gpu_time);
+}
+
+uint64_t FrameStats::WindowPercentile(double percentile) const {
+  if (window_size_ == 0) {
+    return 0;
+  }
+  std::vector<uint64_t> sorted(window_, window_ + window_size_);
+  size_t rank = static_cast<size_t>(percentile / 100.0 * window_size_ + 0.5);
+  rank = std::min(std::max<size_t>(rank, 1), window_size_);
+  std::nth_element(sorted.begin(), sorted.begin() + rank - 1, sorted.end());
+  return sorted[rank - 1];
+}
+
+void FrameStats::PrintSummary(FILE* out) const {
+  fprintf(out,
+          "  frames: %llu, %llu on time, %llu late, %llu dropped; "
+          "vsync to frame done p50=%lluus p95=%lluus p99=%lluus over the "
+          "last %zu; %llu jank streaks, longest %llu\n",
+          (unsigned long long)frames_, (unsigned long long)on_time_,
+          (unsigned long long)late_, (unsigned long long)dropped_,
+          (unsigned long long)WindowPercentile(50) / 1000,
+          (unsigned long long)WindowPercentile(95) / 1000,
+          (unsigned long long)WindowPercentile(99) / 1000, window_size_,
+          (unsigned long long)streaks_, (unsigned long long)longest_streak_);
+  render_time_.PrintSummary(out, "  vsync to present", 1000, "us");
+  swap_time_.PrintSummary(out, "  swap", 1000, "us");
+  gpu_time_.PrintSummary(out, "  present to GPU done", 1000, "us");
+  gpu_render_time_.PrintSummary(out, "  GPU render", 1000, "us");
+  input_latency_.PrintSummary(out, "  input to frame done", 1000, "us");
+  input_latency_tearing_.PrintSummary(out, "  input to frame done, tearing",
+                                      1000, "us");
+}
+
+}  // namespace flutter
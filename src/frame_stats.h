@@ -0,0 +1,106 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_FRAME_STATS_H_
+#define EMBEDDER_FLUTTER_FRAME_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Milestones of one frame, on the engine clock.
+struct FrameTiming {
+  // When the vsync baton was returned, and the vblank it aimed for. Zero
+  // when the engine paces itself.
+  uint64_t vsync_start = 0;
+  uint64_t vsync_target = 0;
+  // The raster thread made the onscreen context current for the frame,
+  // zero if that was not seen.
+  uint64_t raster_start = 0;
+  // OnApplicationPresent entered and eglSwapBuffers returned.
+  uint64_t present = 0;
+  uint64_t swap_done = 0;
+  // The platform loop saw the GPU finish the frame, an upper bound.
+  uint64_t gpu_done = 0;
+  // The compositor's frame callback for the commit.
+  uint64_t frame_done = 0;
+  // First user input before the frame's vsync, zero if there was none.
+  uint64_t input = 0;
+  // Presented with async flips.
+  bool tearing = false;
+};
+
+// Classifies frames against the vblank they aimed for and keeps pacing
+// statistics. Cheap enough to stay on in production. Not thread safe.
+class FrameStats {
+ public:
+  enum class Verdict {
+    // Shown on the vblank it aimed for.
+    kOnTime,
+    // One vblank late.
+    kLate,
+    // Two or more vblanks late, at least one frame slot went unused.
+    kDropped,
+  };
+
+  // Frames in the rolling window the percentiles are taken over.
+  static constexpr size_t kWindow = 240;
+
+  FrameStats();
+
+  // |target| is the vblank the frame should have been shown on.
+  Verdict Record(const FrameTiming& timing, uint64_t target, uint64_t interval);
+
+  // GPU time of one frame's rendering, known a few frames after the frame
+  // itself was recorded.
+  void RecordGpuRenderTime(uint64_t gpu_time);
+
+  // One line with counts, rolling percentiles of vsync to frame done and
+  // jank streaks.
+  void PrintSummary(FILE* out) const;
+
+  uint64_t frames() const { return frames_; }
+
+ private:
+  uint64_t frames_ = 0;
+  uint64_t on_time_ = 0;
+  uint64_t late_ = 0;
+  uint64_t dropped_ = 0;
+  // Consecutive late or dropped frames.
+  uint64_t streak_ = 0;
+  uint64_t longest_streak_ = 0;
+  // Streaks of at least two frames, the kind users notice.
+  uint64_t streaks_ = 0;
+
+  // Start to frame done of the last kWindow frames, nanoseconds.
+  uint64_t window_[kWindow];
+  size_t window_next_ = 0;
+  size_t window_size_ = 0;
+
+  Histogram render_time_;
+  Histogram swap_time_;
+  Histogram gpu_time_;
+  Histogram gpu_render_time_;
+  // Input to frame done, split by presentation mode so the two compare.
+  Histogram input_latency_;
+  Histogram input_latency_tearing_;
+
+  uint64_t WindowPercentile(double percentile) const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameStats);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_FRAME_STATS_H_
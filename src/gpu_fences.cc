@@ -0,0 +1,90 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gpu_fences.h"
+
+#include <utility>
+
+#include "utils.h"
+
+namespace flutter {
+
+bool EGLSyncFunctions::Load(const char* extensions) {
+  *this = EGLSyncFunctions();
+  if (!extensions || !HasExtension(extensions, "EGL_KHR_fence_sync")) {
+    return false;
+  }
+  create = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+      eglGetProcAddress("eglCreateSyncKHR"));
+  destroy = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+      eglGetProcAddress("eglDestroySyncKHR"));
+  client_wait = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(
+      eglGetProcAddress("eglClientWaitSyncKHR"));
+  if (!create || !destroy || !client_wait) {
+    *this = EGLSyncFunctions();
+    return false;
+  }
+  if (HasExtension(extensions, "EGL_KHR_wait_sync")) {
+    wait = reinterpret_cast<PFNEGLWAITSYNCKHRPROC>(
+        eglGetProcAddress("eglWaitSyncKHR"));
+  }
+  return true;
+}
+
+GpuFenceQueue::GpuFenceQueue(EGLDisplay display, const EGLSyncFunctions& sync)
+    : display_(display), sync_(sync) {}
+
+GpuFenceQueue::~GpuFenceQueue() {
+  for (Fence& fence : fences_) {
+    sync_.destroy(display_, fence.sync);
+    fence.callback(0);
+  }
+}
+
+bool GpuFenceQueue::Insert(SignalledCallback callback) {
+  EGLSyncKHR sync = sync_.create(display_, EGL_SYNC_FENCE_KHR, nullptr);
+  if (sync == EGL_NO_SYNC_KHR) {
+    FLWAY_ERR << "Could not create a fence sync: 0x" << std::hex
+              << eglGetError() << std::dec << std::endl;
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  fences_.push_back({sync, std::move(callback)});
+  return true;
+}
+
+void GpuFenceQueue::Poll(uint64_t now) {
+  while (true) {
+    Fence fence;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (fences_.empty()) {
+        return;
+      }
+      // The swap flushed the commands, so no flush bit: it only acts on the
+      // current context, and the polling thread has none.
+      if (sync_.client_wait(display_, fences_.front().sync, 0, 0) !=
+          EGL_CONDITION_SATISFIED_KHR) {
+        // The GPU finishes frames in order.
+        return;
+      }
+      fence = std::move(fences_.front());
+      fences_.pop_front();
+    }
+    sync_.destroy(display_, fence.sync);
+    fence.callback(now);
+  }
+}
+
+size_t GpuFenceQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fences_.size();
+}
+
+}  // namespace flutter
@@ -0,0 +1,84 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_GPU_FENCES_H_
+#define EMBEDDER_FLUTTER_GPU_FENCES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// EGL_KHR_fence_sync entry points, and eglWaitSyncKHR when the display also
+// has EGL_KHR_wait_sync.
+struct EGLSyncFunctions {
+  PFNEGLCREATESYNCKHRPROC create = nullptr;
+  PFNEGLDESTROYSYNCKHRPROC destroy = nullptr;
+  PFNEGLCLIENTWAITSYNCKHRPROC client_wait = nullptr;
+  // May be null.
+  PFNEGLWAITSYNCKHRPROC wait = nullptr;
+
+  // Looks the functions up if |extensions|, the display's, may be null,
+  // lists them. Returns false without fence syncs.
+  bool Load(const char* extensions);
+
+  bool available() const { return create != nullptr; }
+};
+
+// GPU completion of frames. The raster thread puts a fence behind each
+// frame's commands, the platform loop polls them in order without blocking
+// and learns when the GPU finished a frame. Thread safe.
+class GpuFenceQueue {
+ public:
+  // Gets the time the fence was seen signalled, zero if the queue went away
+  // first.
+  using SignalledCallback = std::function<void(uint64_t signalled)>;
+
+  GpuFenceQueue(EGLDisplay display, const EGLSyncFunctions& sync);
+
+  // Destroys the fences still pending and runs their callbacks.
+  ~GpuFenceQueue();
+
+  // Fences the current context's commands so far. Raster thread, context
+  // current. Returns false, dropping |callback|, if that failed.
+  bool Insert(SignalledCallback callback);
+
+  // Runs the callbacks of the fences that signalled by |now|, oldest first.
+  // Needs no current context.
+  void Poll(uint64_t now);
+
+  // Fences not seen signalled yet.
+  size_t size() const;
+
+ private:
+  struct Fence {
+    EGLSyncKHR sync;
+    SignalledCallback callback;
+  };
+
+  EGLDisplay display_;
+  const EGLSyncFunctions sync_;
+  mutable std::mutex mutex_;
+  std::deque<Fence> fences_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(GpuFenceQueue);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_GPU_FENCES_H_
@@ -0,0 +1,120 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gpu_timer.h"
+
+#include <EGL/egl.h>
+
+#include "utils.h"
+
+namespace flutter {
+
+GpuTimer::GpuTimer(const char* extensions) {
+  if (!extensions ||
+      !HasExtension(extensions, "GL_EXT_disjoint_timer_query")) {
+    return;
+  }
+  gen_queries_ = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(
+      eglGetProcAddress("glGenQueriesEXT"));
+  begin_query_ = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(
+      eglGetProcAddress("glBeginQueryEXT"));
+  end_query_ = reinterpret_cast<PFNGLENDQUERYEXTPROC>(
+      eglGetProcAddress("glEndQueryEXT"));
+  get_query_object_uiv_ = reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectuivEXT"));
+  // Optional, the 32 bit result holds four seconds.
+  get_query_object_ui64v_ = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  if (!gen_queries_ || !begin_query_ || !end_query_ ||
+      !get_query_object_uiv_) {
+    gen_queries_ = nullptr;
+  }
+}
+
+void GpuTimer::Begin() {
+  if (!gen_queries_ || active_) {
+    return;
+  }
+  if (queries_[0] == 0) {
+    gen_queries_(kQueries, queries_);
+  }
+  Collect();
+  if (pending_ == kQueries) {
+    return;
+  }
+  begin_query_(GL_TIME_ELAPSED_EXT, queries_[(first_ + pending_) % kQueries]);
+  active_ = true;
+}
+
+void GpuTimer::End() {
+  if (!active_) {
+    return;
+  }
+  end_query_(GL_TIME_ELAPSED_EXT);
+  active_ = false;
+  pending_++;
+}
+
+void GpuTimer::Drop() {
+  if (!active_) {
+    return;
+  }
+  dropped_[(first_ + pending_) % kQueries] = true;
+  End();
+}
+
+void GpuTimer::TakeResults(std::vector<uint64_t>* times) {
+  times->clear();
+  std::lock_guard<std::mutex> lock(results_mutex_);
+  // Swapped, so both vectors keep their capacity.
+  results_.swap(*times);
+}
+
+void GpuTimer::Collect() {
+  // Power management or a GPU reset reset the counter; the results in
+  // flight are garbage but still have to be drained.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+  while (pending_ > 0) {
+    const GLuint query = queries_[first_];
+    GLuint available = 0;
+    get_query_object_uiv_(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available) {
+      // Results come in order.
+      break;
+    }
+    uint64_t elapsed;
+    if (get_query_object_ui64v_) {
+      GLuint64 result = 0;
+      get_query_object_ui64v_(query, GL_QUERY_RESULT_EXT, &result);
+      elapsed = result;
+    } else {
+      GLuint result = 0;
+      get_query_object_uiv_(query, GL_QUERY_RESULT_EXT, &result);
+      elapsed = result;
+    }
+    const bool dropped = dropped_[first_];
+    dropped_[first_] = false;
+    first_ = (first_ + 1) % kQueries;
+    pending_--;
+
+    if (dropped) {
+      continue;
+    }
+    if (disjoint) {
+      disjoint_count_++;
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(results_mutex_);
+    results_.push_back(elapsed);
+  }
+}
+
+}  // namespace flutter
@@ -0,0 +1,87 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_GPU_TIMER_H_
+#define EMBEDDER_FLUTTER_GPU_TIMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// GPU cost of frames with GL_EXT_disjoint_timer_query. Each frame's
+// rendering is wrapped in a GL_TIME_ELAPSED query. Results are read without
+// stalling once the GPU has them, a few frames later, and handed to another
+// thread. Frames are left untimed while every query is still in flight.
+// Render context thread, except TakeResults() and disjoint_count().
+class GpuTimer {
+ public:
+  // |extensions| is the render context's GL_EXTENSIONS, may be null.
+  explicit GpuTimer(const char* extensions);
+
+  bool IsValid() const { return gen_queries_ != nullptr; }
+
+  // Starts timing a frame. The render context is current. Nothing if a
+  // frame is already being timed.
+  void Begin();
+
+  // Stops timing the frame at present.
+  void End();
+
+  // Ends the running query, if any, and drops its result. For a context
+  // released in the middle of a frame.
+  void Drop();
+
+  // Moves the frame times read so far, in nanoseconds, into |times|, which
+  // is cleared first. Thread safe.
+  void TakeResults(std::vector<uint64_t>* times);
+
+  // Results dropped because the GPU clock was disjoint. Thread safe.
+  uint64_t disjoint_count() const { return disjoint_count_.load(); }
+
+ private:
+  static constexpr size_t kQueries = 4;
+
+  PFNGLGENQUERIESEXTPROC gen_queries_ = nullptr;
+  PFNGLBEGINQUERYEXTPROC begin_query_ = nullptr;
+  PFNGLENDQUERYEXTPROC end_query_ = nullptr;
+  PFNGLGETQUERYOBJECTUIVEXTPROC get_query_object_uiv_ = nullptr;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_object_ui64v_ = nullptr;
+
+  // Query objects belong to the render context, generated on first use.
+  GLuint queries_[kQueries] = {};
+  // The oldest query in flight, and how many are.
+  size_t first_ = 0;
+  size_t pending_ = 0;
+  bool active_ = false;
+  // The result of the query in that slot is not a whole frame.
+  bool dropped_[kQueries] = {};
+
+  std::mutex results_mutex_;
+  std::vector<uint64_t> results_;
+  std::atomic<uint64_t> disjoint_count_{0};
+
+  // Reads the results that are available, oldest first.
+  void Collect();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(GpuTimer);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_GPU_TIMER_H_
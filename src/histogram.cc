@@ -0,0 +1,109 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "histogram.h"
+
+#include <string.h>
+
+namespace flutter {
+
+Histogram::Histogram() {
+  Reset();
+}
+
+void Histogram::Merge(const Histogram& other) {
+  for (unsigned i = 0; i < kBuckets; i++) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  if (other.min_ < min_) {
+    min_ = other.min_;
+  }
+  if (other.max_ > max_) {
+    max_ = other.max_;
+  }
+}
+
+void Histogram::Reset() {
+  memset(counts_, 0, sizeof(counts_));
+  count_ = 0;
+  sum_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+uint64_t Histogram::BucketUpperBound(unsigned index) {
+  // The first two rows hold one value per bucket.
+  if (index < 2 * kSubBuckets) {
+    return index;
+  }
+  const unsigned shift = index / kSubBuckets - 1;
+  const uint64_t mantissa = index - shift * kSubBuckets;
+  // Wraps to UINT64_MAX for the very last bucket.
+  return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t Histogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      // Never report beyond what was actually recorded.
+      const uint64_t bound = BucketUpperBound(i);
+      return bound < max_ ? bound : max_;
+    }
+  }
+  return max_;
+}
+
+void Histogram::PrintSummary(FILE* out,
+                             const char* name,
+                             uint64_t scale,
+                             const char* unit) const {
+  fprintf(out,
+          "%s: n=%llu mean=%llu%s p50=%llu%s p90=%llu%s p99=%llu%s "
+          "p99.9=%llu%s max=%llu%s\n",
+          name, (unsigned long long)count_,
+          (unsigned long long)(mean() / scale), unit,
+          (unsigned long long)(ValueAtPercentile(50) / scale), unit,
+          (unsigned long long)(ValueAtPercentile(90) / scale), unit,
+          (unsigned long long)(ValueAtPercentile(99) / scale), unit,
+          (unsigned long long)(ValueAtPercentile(99.9) / scale), unit,
+          (unsigned long long)(max_ / scale), unit);
+}
+
+void Histogram::PrintBuckets(FILE* out,
+                             const char* name,
+                             uint64_t scale,
+                             const char* unit) const {
+  PrintSummary(out, name, scale, unit);
+
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < kBuckets; i++) {
+    if (counts_[i] == 0) {
+      continue;
+    }
+    seen += counts_[i];
+    fprintf(out, "  <= %llu%s: %llu (%.2f%% cumulative)\n",
+            (unsigned long long)(BucketUpperBound(i) / scale), unit,
+            (unsigned long long)counts_[i], 100.0 * seen / count_);
+  }
+}
+
+}  // namespace flutter
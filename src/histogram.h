@@ -0,0 +1,96 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_HISTOGRAM_H_
+#define EMBEDDER_FLUTTER_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Log-linear histogram in the style of HdrHistogram. Every power of two is
+// split into 16 linear buckets, so any recorded value is reported within
+// 1/16 of itself, from 1 up to UINT64_MAX, in a fixed 8KB table. Recording is
+// a few instructions and never allocates. Not thread safe.
+class Histogram {
+ public:
+  static constexpr unsigned kSubBucketBits = 4;
+  static constexpr unsigned kSubBuckets = 1 << kSubBucketBits;
+  static constexpr unsigned kBuckets = (65 - kSubBucketBits) * kSubBuckets;
+
+  Histogram();
+
+  void Record(uint64_t value) {
+    counts_[BucketIndex(value)]++;
+    count_++;
+    sum_ += value;
+    if (value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  void Merge(const Histogram& other);
+
+  void Reset();
+
+  uint64_t count() const { return count_; }
+
+  uint64_t min() const { return count_ ? min_ : 0; }
+
+  uint64_t max() const { return max_; }
+
+  uint64_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+  // Smallest recorded value that |percentile| percent of the values do not
+  // exceed, rounded up to the end of its bucket.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  // One line: count, mean, p50, p90, p99, p99.9 and max, each value divided
+  // by |scale| and followed by |unit|.
+  void PrintSummary(FILE* out,
+                    const char* name,
+                    uint64_t scale,
+                    const char* unit) const;
+
+  // The summary followed by every non-empty bucket.
+  void PrintBuckets(FILE* out,
+                    const char* name,
+                    uint64_t scale,
+                    const char* unit) const;
+
+ private:
+  uint64_t counts_[kBuckets];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+
+  static unsigned BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<unsigned>(value);
+    }
+    const unsigned shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+    return shift * kSubBuckets + static_cast<unsigned>(value >> shift);
+  }
+
+  // Largest value that falls into bucket |index|.
+  static uint64_t BucketUpperBound(unsigned index);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_HISTOGRAM_H_
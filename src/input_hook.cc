@@ -86,6 +86,22 @@ WaylandDisplay::wl_keyboard_key(void *data, struct wl_keyboard *wl_keyboard,
 {
     LOG_ERROR(stderr, "[wl_keyboard] wl_keyboard_key serial:%d keycode:0x%08x state:%d\n", serial, key, state);
 
+    WaylandDisplay* myWayland = reinterpret_cast<WaylandDisplay*>(data);
+    myWayland->DeliverKeyEvent(key, state);
+  // WaylandDisplay* myWayland = reinterpret_cast<WaylandDisplay*>(data);
+  // char buf[128];
+  // uint32_t keycode = key + 8;
+  // xkb_keysym_t sym = xkb_state_key_get_one_sym(myWayland->xkb_state, keycode);
+  // xkb_keysym_get_name(sym, buf, sizeof(buf));
+  // const char* action =
+  //     state == WL_KEYBOARD_KEY_STATE_PRESSED ? "press" : "release";
+  // LOG_ERROR(stderr, "key %s: sym: %-12s (%d), ", action, buf, sym);
+  // xkb_state_key_get_utf8(myWayland->xkb_state, keycode, buf, sizeof(buf));
+  // LOG_ERROR(stderr, "utf8: '%s'\n", buf);
+}
+
+void WaylandDisplay::SendKeyEvent(uint32_t key, uint32_t state)
+{
         static constexpr char kChannelName[] = "flutter/keyevent";  //flutter默认channelname
 
         static constexpr char kKeyCodeKey[] = "keyCode";
@@ -135,16 +151,6 @@ WaylandDisplay::wl_keyboard_key(void *data, struct wl_keyboard *wl_keyboard,
         if (result != kSuccess)
           FLWAY_LOG << "FlutterEngineSendPlatformMessage Result: " << result
                     << std::endl;
-  // WaylandDisplay* myWayland = reinterpret_cast<WaylandDisplay*>(data);
-  // char buf[128];
-  // uint32_t keycode = key + 8;
-  // xkb_keysym_t sym = xkb_state_key_get_one_sym(myWayland->xkb_state, keycode);
-  // xkb_keysym_get_name(sym, buf, sizeof(buf));
-  // const char* action =
-  //     state == WL_KEYBOARD_KEY_STATE_PRESSED ? "press" : "release";
-  // LOG_ERROR(stderr, "key %s: sym: %-12s (%d), ", action, buf, sym);
-  // xkb_state_key_get_utf8(myWayland->xkb_state, keycode, buf, sizeof(buf));
-  // LOG_ERROR(stderr, "utf8: '%s'\n", buf);
 }
 
 void
@@ -308,7 +314,7 @@ void WaylandDisplay::wl_touch_down(void* data,
                             .scroll_delta_y = 0.0,
                             .device_kind = kFlutterPointerDeviceKindTouch,
                             .buttons = 0};
-  FlutterApplication::SendInputEventToFlutter(&singlePointerEvent, 1);
+  myWayland->DeliverPointerEvent(singlePointerEvent);
 }
 
 void WaylandDisplay::wl_touch_up(void* data,
@@ -336,7 +342,7 @@ void WaylandDisplay::wl_touch_up(void* data,
                             .scroll_delta_y = 0.0,
                             .device_kind = kFlutterPointerDeviceKindTouch,
                             .buttons = 0};
-  FlutterApplication::SendInputEventToFlutter(&singlePointerEvent, 1);
+  myWayland->DeliverPointerEvent(singlePointerEvent);
 }
 
 void WaylandDisplay::wl_touch_motion(void* data,
@@ -368,7 +374,7 @@ void WaylandDisplay::wl_touch_motion(void* data,
                             .scroll_delta_y = 0.0,
                             .device_kind = kFlutterPointerDeviceKindTouch,
                             .buttons = 0};
-  FlutterApplication::SendInputEventToFlutter(&singlePointerEvent, 1);
+  myWayland->DeliverPointerEvent(singlePointerEvent);
 }
 
 void WaylandDisplay::wl_touch_cancel(void* data, struct wl_touch* wl_touch) {
@@ -479,5 +485,76 @@ void WaylandDisplay::wl_touch_frame(void* data, struct wl_touch* wl_touch) {
 //   }
 }
 
+// Input objects on the private queue are only dispatched by the reader thread,
+// which must not call into the engine itself.
+void WaylandDisplay::DeliverPointerEvent(FlutterPointerEvent event) {
+  // The engine takes microseconds on its own clock.
+  const uint64_t received = FlutterEngineGetCurrentTime();
+  event.timestamp = received / 1000;
+
+  if (input_queue_ == nullptr) {
+    OnUserInput();
+    SendPointerEvent(event);
+    return;
+  }
+
+  input_record record = {};
+  record.type = input_record::kPointer;
+  record.pointer = event;
+  record.queued_at = received;
+  if (!input_records_.Push(record)) {
+    input_records_dropped_++;
+    return;
+  }
+  loop_.Wakeup();
+}
+
+void WaylandDisplay::DeliverKeyEvent(uint32_t key, uint32_t state) {
+  if (input_queue_ == nullptr) {
+    OnUserInput();
+    SendKeyEvent(key, state);
+    return;
+  }
+
+  input_record record = {};
+  record.type = input_record::kKey;
+  record.key = key;
+  record.key_state = state;
+  record.queued_at = FlutterEngineGetCurrentTime();
+  if (!input_records_.Push(record)) {
+    input_records_dropped_++;
+    return;
+  }
+  loop_.Wakeup();
+}
+
+// Surface coordinates span the screen size, the engine's physical pixels
+// the render size.
+void WaylandDisplay::SendPointerEvent(FlutterPointerEvent event) {
+  event.x *= render_scale_;
+  event.y *= render_scale_;
+  FlutterApplication::SendInputEventToFlutter(&event, 1);
+}
+
+void WaylandDisplay::DeliverQueuedInput() {
+  LaneStats& stats = lane_stats_[static_cast<size_t>(WorkLane::kInput)];
+  const uint64_t now = FlutterEngineGetCurrentTime();
+  input_record record;
+  if (!input_records_.empty()) {
+    OnUserInput();
+  }
+  while (input_records_.Pop(&record)) {
+    stats.Record(now > record.queued_at ? now - record.queued_at : 0);
+    switch (record.type) {
+      case input_record::kPointer:
+        SendPointerEvent(record.pointer);
+        break;
+      case input_record::kKey:
+        SendKeyEvent(record.key, record.key_state);
+        break;
+    }
+  }
+}
+
 }  // namespace flutter
 
@@ -0,0 +1,416 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WL_EGL_PLATFORM
+#define WL_EGL_PLATFORM 1
+#endif
+
+#include "layer_compositor.h"
+
+#include <math.h>
+
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+
+#include "log.h"
+
+namespace flutter {
+
+namespace {
+
+// A full viewport quad sampling the texture the same way up. Backing
+// stores and window surfaces both have their origin at the bottom left.
+constexpr char kVertexShader[] =
+    "attribute vec2 position;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "  uv = position * 0.5 + 0.5;\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "}\n";
+
+constexpr char kFragmentShader[] =
+    "precision mediump float;\n"
+    "uniform sampler2D texture;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "  gl_FragColor = texture2D(texture, uv);\n"
+    "}\n";
+
+constexpr GLfloat kQuad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled != GL_TRUE) {
+    char log[512] = {};
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    FLWAY_ERR << "Could not compile the layer shader: " << log << std::endl;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+size_t PixelSize(double size) {
+  return static_cast<size_t>(std::max(1L, lround(size)));
+}
+
+// In the render context.
+bool CreateFramebuffer(PooledBackingStore* store) {
+  // Skia caches these bindings for the render context.
+  GLint bound_texture = 0;
+  GLint bound_framebuffer = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_framebuffer);
+
+  glGenTextures(1, &store->texture);
+  glBindTexture(GL_TEXTURE_2D, store->texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, store->width, store->height, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+  glGenFramebuffers(1, &store->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, store->framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         store->texture, 0);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+  glBindTexture(GL_TEXTURE_2D, bound_texture);
+  glBindFramebuffer(GL_FRAMEBUFFER, bound_framebuffer);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    FLWAY_ERR << "Backing store framebuffer incomplete: 0x" << std::hex
+              << status << std::dec << std::endl;
+    glDeleteFramebuffers(1, &store->framebuffer);
+    glDeleteTextures(1, &store->texture);
+    return false;
+  }
+  return true;
+}
+
+void DeleteFramebuffer(const PooledBackingStore& store) {
+  glDeleteFramebuffers(1, &store.framebuffer);
+  glDeleteTextures(1, &store.texture);
+}
+
+}  // namespace
+
+LayerCompositor::LayerCompositor(wl_compositor* compositor,
+                                 wl_subcompositor* subcompositor,
+                                 wl_surface* parent,
+                                 EGLDisplay display,
+                                 EGLConfig config,
+                                 EGLContext context,
+                                 size_t budget_bytes)
+    : compositor_(compositor),
+      subcompositor_(subcompositor),
+      parent_(parent),
+      display_(display),
+      config_(config),
+      context_(context),
+      pool_(budget_bytes, CreateFramebuffer, DeleteFramebuffer) {}
+
+LayerCompositor::~LayerCompositor() {
+  pool_.PrintSummary(stdout);
+  // GL objects go with the contexts.
+  for (PooledBackingStore* store : collected_) {
+    delete store;
+  }
+  for (LayerSurface& layer : layer_surfaces_) {
+    DestroyLayerSurface(&layer);
+  }
+  for (auto& view : views_) {
+    if (view.second.subsurface) {
+      wl_subsurface_destroy(view.second.subsurface);
+    }
+    wl_surface_destroy(view.second.surface);
+  }
+}
+
+bool LayerCompositor::CreateBackingStore(
+    const FlutterBackingStoreConfig* config,
+    FlutterBackingStore* backing_store) {
+  // Collected stores first, so this frame's requests can reuse them.
+  ReleaseCollected();
+
+  PooledBackingStore* store =
+      pool_.Acquire(PixelSize(config->size.width),
+                    PixelSize(config->size.height), GL_RGBA8_OES);
+  if (!store) {
+    return false;
+  }
+
+  backing_store->type = kFlutterBackingStoreTypeOpenGL;
+  backing_store->user_data = store;
+  backing_store->open_gl.type = kFlutterOpenGLTargetTypeFramebuffer;
+  backing_store->open_gl.framebuffer.target = store->format;
+  backing_store->open_gl.framebuffer.name = store->framebuffer;
+  backing_store->open_gl.framebuffer.user_data = store;
+  // Returned to the pool by CollectBackingStore().
+  backing_store->open_gl.framebuffer.destruction_callback = [](void*) {};
+  return true;
+}
+
+bool LayerCompositor::CollectBackingStore(
+    const FlutterBackingStore* backing_store) {
+  collected_.push_back(
+      static_cast<PooledBackingStore*>(backing_store->user_data));
+  return true;
+}
+
+void LayerCompositor::ReleaseCollected() {
+  for (PooledBackingStore* store : collected_) {
+    pool_.Release(store);
+  }
+  collected_.clear();
+}
+
+bool LayerCompositor::PresentLayers(const FlutterLayer** layers,
+                                    size_t count,
+                                    EGLSurface main_surface,
+                                    EGLContext render_context,
+                                    size_t main_width,
+                                    size_t main_height) {
+  ReleaseCollected();
+  // The copies read what the render context drew from another context.
+  glFlush();
+
+  const FlutterLayer* bottom = nullptr;
+  size_t first = 0;
+  if (count > 0 && layers[0]->type == kFlutterLayerContentTypeBackingStore) {
+    bottom = layers[0];
+    first = 1;
+  }
+
+  bool ok = true;
+  size_t layer_count = 0;
+  wl_surface* below = parent_;
+  std::vector<FlutterPlatformViewIdentifier> shown_views;
+  for (size_t i = first; i < count; i++) {
+    const FlutterLayer* layer = layers[i];
+    const int32_t x = static_cast<int32_t>(lround(layer->offset.x));
+    const int32_t y = static_cast<int32_t>(lround(layer->offset.y));
+
+    if (layer->type == kFlutterLayerContentTypePlatformView) {
+      const FlutterPlatformViewIdentifier id =
+          layer->platform_view->identifier;
+      wl_surface* surface = PlatformViewSurface(id);
+      std::lock_guard<std::mutex> lock(views_mutex_);
+      ViewSurface& view = views_[id];
+      if (!view.subsurface) {
+        view.subsurface =
+            wl_subcompositor_get_subsurface(subcompositor_, surface, parent_);
+      }
+      wl_subsurface_set_position(view.subsurface, x, y);
+      wl_subsurface_place_above(view.subsurface, below);
+      shown_views.push_back(id);
+      below = surface;
+      continue;
+    }
+
+    if (layer_count == layer_surfaces_.size()) {
+      layer_surfaces_.emplace_back();
+    }
+    LayerSurface& surface = layer_surfaces_[layer_count++];
+    const PooledBackingStore* store =
+        static_cast<const PooledBackingStore*>(layer->backing_store->user_data);
+    if (!CreateLayerSurface(&surface, store->width, store->height)) {
+      ok = false;
+      continue;
+    }
+    wl_subsurface_set_position(surface.subsurface, x, y);
+    wl_subsurface_place_above(surface.subsurface, below);
+    below = surface.surface;
+
+    if (eglMakeCurrent(display_, surface.egl_surface, surface.egl_surface,
+                       context_) != EGL_TRUE) {
+      FLWAY_ERR << "Could not make a layer surface current." << std::endl;
+      ok = false;
+      continue;
+    }
+    glViewport(0, 0, surface.width, surface.height);
+    DrawTexture(store);
+    // Cached until the main surface commits.
+    if (eglSwapBuffers(display_, surface.egl_surface) != EGL_TRUE) {
+      FLWAY_ERR << "Could not swap a layer surface." << std::endl;
+      ok = false;
+    }
+  }
+
+  // Layers that went away.
+  for (size_t i = layer_count; i < layer_surfaces_.size(); i++) {
+    DestroyLayerSurface(&layer_surfaces_[i]);
+  }
+  layer_surfaces_.resize(layer_count);
+  {
+    std::lock_guard<std::mutex> lock(views_mutex_);
+    for (auto& view : views_) {
+      if (view.second.subsurface &&
+          std::find(shown_views.begin(), shown_views.end(), view.first) ==
+              shown_views.end()) {
+        wl_subsurface_destroy(view.second.subsurface);
+        view.second.subsurface = nullptr;
+      }
+    }
+  }
+
+  if (eglMakeCurrent(display_, main_surface, main_surface, context_) !=
+      EGL_TRUE) {
+    FLWAY_ERR << "Could not make the main surface current for the layers."
+              << std::endl;
+    ok = false;
+  } else {
+    glViewport(0, 0, main_width, main_height);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (bottom) {
+      const PooledBackingStore* store =
+          static_cast<const PooledBackingStore*>(bottom->backing_store->user_data);
+      // GL counts from the bottom left.
+      const GLint x = static_cast<GLint>(lround(bottom->offset.x));
+      const GLint y = static_cast<GLint>(main_height) -
+                      static_cast<GLint>(lround(bottom->offset.y)) -
+                      static_cast<GLint>(store->height);
+      glViewport(x, y, store->width, store->height);
+      DrawTexture(store);
+    }
+  }
+
+  if (eglMakeCurrent(display_, main_surface, main_surface, render_context) !=
+      EGL_TRUE) {
+    FLWAY_ERR << "Could not make the render context current again."
+              << std::endl;
+    return false;
+  }
+  return ok;
+}
+
+wl_surface* LayerCompositor::PlatformViewSurface(
+    FlutterPlatformViewIdentifier id) {
+  std::lock_guard<std::mutex> lock(views_mutex_);
+  ViewSurface& view = views_[id];
+  if (!view.surface) {
+    view.surface = wl_compositor_create_surface(compositor_);
+    ClearInputRegion(view.surface);
+  }
+  return view.surface;
+}
+
+bool LayerCompositor::CreateLayerSurface(LayerSurface* layer,
+                                         size_t width,
+                                         size_t height) {
+  if (layer->egl_surface != EGL_NO_SURFACE) {
+    if (layer->width != width || layer->height != height) {
+      wl_egl_window_resize(layer->window, width, height, 0, 0);
+      layer->width = width;
+      layer->height = height;
+    }
+    return true;
+  }
+
+  layer->surface = wl_compositor_create_surface(compositor_);
+  layer->subsurface =
+      wl_subcompositor_get_subsurface(subcompositor_, layer->surface, parent_);
+  ClearInputRegion(layer->surface);
+  layer->window = wl_egl_window_create(layer->surface, width, height);
+  layer->width = width;
+  layer->height = height;
+  layer->egl_surface =
+      eglCreateWindowSurface(display_, config_, layer->window, nullptr);
+  if (layer->egl_surface == EGL_NO_SURFACE) {
+    FLWAY_ERR << "Could not create a layer surface." << std::endl;
+    DestroyLayerSurface(layer);
+    return false;
+  }
+
+  // The main surface's swap paces the frame, a subsurface's commit is only
+  // cached until then.
+  if (eglMakeCurrent(display_, layer->egl_surface, layer->egl_surface,
+                     context_) != EGL_TRUE ||
+      eglSwapInterval(display_, 0) != EGL_TRUE) {
+    FLWAY_ERR << "Could not set up a layer surface." << std::endl;
+  }
+  return true;
+}
+
+void LayerCompositor::DestroyLayerSurface(LayerSurface* layer) {
+  if (layer->egl_surface != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, layer->egl_surface);
+  }
+  if (layer->window) {
+    wl_egl_window_destroy(layer->window);
+  }
+  if (layer->subsurface) {
+    wl_subsurface_destroy(layer->subsurface);
+  }
+  if (layer->surface) {
+    wl_surface_destroy(layer->surface);
+  }
+  *layer = LayerSurface();
+}
+
+void LayerCompositor::ClearInputRegion(wl_surface* surface) {
+  wl_region* region = wl_compositor_create_region(compositor_);
+  wl_surface_set_input_region(surface, region);
+  wl_region_destroy(region);
+}
+
+bool LayerCompositor::BuildProgram() {
+  GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  if (!vertex_shader || !fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return false;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glLinkProgram(program);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    FLWAY_ERR << "Could not link the layer program." << std::endl;
+    glDeleteProgram(program);
+    return false;
+  }
+
+  program_ = program;
+  position_location_ = glGetAttribLocation(program_, "position");
+  glUseProgram(program_);
+  glUniform1i(glGetUniformLocation(program_, "texture"), 0);
+  // Copies, the surfaces hold premultiplied alpha as is.
+  glDisable(GL_BLEND);
+  return true;
+}
+
+void LayerCompositor::DrawTexture(const PooledBackingStore* store) {
+  if (!program_ && !BuildProgram()) {
+    return;
+  }
+  // |context_| is ours alone, the state set up once stays.
+  glUseProgram(program_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, store->texture);
+  glVertexAttribPointer(position_location_, 2, GL_FLOAT, GL_FALSE, 0, kQuad);
+  glEnableVertexAttribArray(position_location_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+}  // namespace flutter
@@ -0,0 +1,141 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_LAYER_COMPOSITOR_H_
+#define EMBEDDER_FLUTTER_LAYER_COMPOSITOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <flutter_embedder.h>
+#include <wayland-client.h>
+#include <wayland-egl.h>
+
+#include "backing_store_pool.h"
+#include "macros.h"
+
+namespace flutter {
+
+// The engine's FlutterCompositor on Wayland. Backing stores are textures
+// behind framebuffers the engine renders into with the render context. At
+// present the bottom layer is drawn into the main surface and every later
+// backing store into a wl_subsurface of its own with its own EGL window,
+// stacked in layer order. A platform view gets a bare subsurface, whoever
+// produces its content (a video decoder handing out dmabufs, say) attaches
+// buffers to it directly, so the compositor can scan it out on an overlay
+// plane while the UI layers stay in GL.
+//
+// Subsurfaces are synchronized, their state applies with the main
+// surface's commit and a frame's layers show up together. Copies into the
+// surfaces use |context|, which shares textures with the render context
+// but keeps its GL state away from the engine's. Raster thread only,
+// except PlatformViewSurface().
+class LayerCompositor {
+ public:
+  // Free backing stores are kept while all of them take up no more than
+  // |budget_bytes|.
+  LayerCompositor(wl_compositor* compositor,
+                  wl_subcompositor* subcompositor,
+                  wl_surface* parent,
+                  EGLDisplay display,
+                  EGLConfig config,
+                  EGLContext context,
+                  size_t budget_bytes);
+
+  ~LayerCompositor();
+
+  // The render context is current.
+  bool CreateBackingStore(const FlutterBackingStoreConfig* config,
+                          FlutterBackingStore* backing_store);
+
+  bool CollectBackingStore(const FlutterBackingStore* backing_store);
+
+  // Swaps the subsurfaces and draws the bottom layer into |main_surface|,
+  // |main_width| x |main_height|. Returns with |render_context| current on
+  // |main_surface|, whose swap commits the frame. The render context is
+  // current on entry.
+  bool PresentLayers(const FlutterLayer** layers,
+                     size_t count,
+                     EGLSurface main_surface,
+                     EGLContext render_context,
+                     size_t main_width,
+                     size_t main_height);
+
+  // The surface platform view |id| is shown in, for its producer to attach
+  // buffers to. Stays valid for the compositor's lifetime, it is unmapped
+  // while the view is not in the layer tree. Thread safe.
+  wl_surface* PlatformViewSurface(FlutterPlatformViewIdentifier id);
+
+ private:
+  // One backing store layer above the bottom one.
+  struct LayerSurface {
+    wl_surface* surface = nullptr;
+    wl_subsurface* subsurface = nullptr;
+    wl_egl_window* window = nullptr;
+    EGLSurface egl_surface = EGL_NO_SURFACE;
+    size_t width = 0;
+    size_t height = 0;
+  };
+
+  struct ViewSurface {
+    wl_surface* surface = nullptr;
+    // Null while the view is not laid out.
+    wl_subsurface* subsurface = nullptr;
+  };
+
+  wl_compositor* compositor_;
+  wl_subcompositor* subcompositor_;
+  wl_surface* parent_;
+  EGLDisplay display_;
+  EGLConfig config_;
+  EGLContext context_;
+
+  // Copies a texture into the current surface, lazily built in |context_|.
+  GLuint program_ = 0;
+  GLint position_location_ = -1;
+
+  std::vector<LayerSurface> layer_surfaces_;
+
+  std::mutex views_mutex_;
+  std::map<FlutterPlatformViewIdentifier, ViewSurface> views_;
+
+  BackingStorePool pool_;
+
+  // Collected backing stores. Framebuffers are not shared between contexts,
+  // so they go back to the pool the next time the render context is
+  // current.
+  std::vector<PooledBackingStore*> collected_;
+
+  void ReleaseCollected();
+
+  bool CreateLayerSurface(LayerSurface* layer, size_t width, size_t height);
+
+  void DestroyLayerSurface(LayerSurface* layer);
+
+  // Input goes to the main surface, the subsurfaces take none.
+  void ClearInputRegion(wl_surface* surface);
+
+  bool BuildProgram();
+
+  // Draws |store| over the viewport.
+  void DrawTexture(const PooledBackingStore* store);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(LayerCompositor);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_LAYER_COMPOSITOR_H_
@@ -15,7 +15,9 @@
 #include <unistd.h>
 
 #include "log.h"
+#include "embedder_options.h"
 #include "flutter_application.h"
+#include "thread_checker.h"
 #include "utils.h"
 #include "wayland_display.h"
 #include "input_hook.h"
@@ -28,9 +30,58 @@ static void PrintUsage() {
   std::cerr << "Usage: `" << GetExecutableName()
             << " <asset_bundle_path> <flutter_flags>`" << std::endl
             << std::endl;
+  std::cerr << "Options:" << std::endl
+            << "  -d, --dimensions=W,H    view size in pixels" << std::endl
+            << "  -b, --task-budget=US    max time per loop iteration spent "
+               "on engine tasks, 0 for no limit" << std::endl
+            << "  -t, --threads=MODE      raster thread: platform (merged), "
+               "engine (default) or raster (embedder owned)" << std::endl
+            << "      --raster-cpu=N      pin the embedder owned raster thread"
+            << std::endl
+            << "      --check-threads     abort on wayland / EGL use from the "
+               "wrong thread (default in debug builds)" << std::endl
+            << "      --input-thread      read input events on a dedicated "
+               "thread" << std::endl
+            << "      --stats-interval=S  print platform task statistics every "
+               "S seconds (SIGUSR1 dumps them at any time)" << std::endl
+            << "      --watchdog=MS       report platform thread stalls longer "
+               "than MS, 0 to disable (default 2000)" << std::endl
+            << "      --no-vsync          let the engine pace frames with its "
+               "own timer" << std::endl
+            << "      --no-partial-repaint  repaint and swap the whole surface "
+               "every frame" << std::endl
+            << "      --translucent       the app draws with transparency, "
+               "the surface is not declared opaque" << std::endl
+            << "      --swap-interval=N   vblanks a swap waits for, 0 to "
+               "never block in the driver (default 1)" << std::endl
+            << "      --swap-thread       call eglSwapBuffers from a "
+               "dedicated thread" << std::endl
+            << "      --tearing           present with async flips for the "
+               "lowest latency, frames may tear" << std::endl
+            << "      --compositor        composite the engine's layers in "
+               "Wayland subsurfaces" << std::endl
+            << "      --backing-store-budget=MB  memory the compositor keeps "
+               "layers in before freeing unused ones (default 64)"
+            << std::endl
+            << "      --gpu-max-behind=N  hold vsync while the GPU is more than "
+               "N frames behind, 0 to disable (default 2)" << std::endl
+            << "      --hidden-timeout=MS pause the app when no frame callback "
+               "came for MS, 0 to disable (default 1000)" << std::endl
+            << "      --fps=N             cap the frame rate, e.g. 15, 30, 60 "
+               "or native (default)" << std::endl
+            << "      --idle-after=N      drop to the idle frame rate after N "
+               "frames without input" << std::endl
+            << "      --idle-fps=N        idle frame rate (default 10)"
+            << std::endl
+            << "      --render-scale=S    render at S times the view size and "
+               "let the compositor scale up, 0.25 to 1" << std::endl
+            << "      --dynamic-render-scale=MIN  lower the render scale down "
+               "to MIN while frames miss their budget" << std::endl
+            << std::endl;
 }
 
 struct wlFlutter myWlFlutter;
+EmbedderOptions myEmbedderOptions;
 int myDefaultDisplayWidth;
 int myDefaultDisplayHeight;
 
@@ -40,6 +91,14 @@ bool parse_cmd_args(int argc, char** argv) {
   int longopt_index = 0;
   int runtime_mode_int = kDebug;
   int disable_text_input_int = false;
+  int check_threads_int = false;
+  int input_thread_int = false;
+  int disable_vsync_int = false;
+  int disable_partial_repaint_int = false;
+  int translucent_int = false;
+  int swap_thread_int = false;
+  int tearing_int = false;
+  int compositor_int = false;
   int ok;
 
   struct option long_options[] = {
@@ -49,6 +108,28 @@ bool parse_cmd_args(int argc, char** argv) {
       {"rotation", required_argument, NULL, 'r'},
       {"no-text-input", no_argument, &disable_text_input_int, true},
       {"dimensions", required_argument, NULL, 'd'},
+      {"task-budget", required_argument, NULL, 'b'},
+      {"threads", required_argument, NULL, 't'},
+      {"raster-cpu", required_argument, NULL, 'C'},
+      {"check-threads", no_argument, &check_threads_int, true},
+      {"input-thread", no_argument, &input_thread_int, true},
+      {"stats-interval", required_argument, NULL, 'S'},
+      {"watchdog", required_argument, NULL, 'W'},
+      {"no-vsync", no_argument, &disable_vsync_int, true},
+      {"no-partial-repaint", no_argument, &disable_partial_repaint_int, true},
+      {"translucent", no_argument, &translucent_int, true},
+      {"swap-interval", required_argument, NULL, 'V'},
+      {"swap-thread", no_argument, &swap_thread_int, true},
+      {"tearing", no_argument, &tearing_int, true},
+      {"compositor", no_argument, &compositor_int, true},
+      {"backing-store-budget", required_argument, NULL, 'M'},
+      {"gpu-max-behind", required_argument, NULL, 'G'},
+      {"hidden-timeout", required_argument, NULL, 'H'},
+      {"fps", required_argument, NULL, 'F'},
+      {"idle-after", required_argument, NULL, 'A'},
+      {"idle-fps", required_argument, NULL, 'I'},
+      {"render-scale", required_argument, NULL, 'R'},
+      {"dynamic-render-scale", required_argument, NULL, 'D'},
       {"help", no_argument, 0, 'h'},
       {0, 0, 0, 0}};
 
@@ -59,7 +140,7 @@ bool parse_cmd_args(int argc, char** argv) {
   bool finished_parsing_options = false;
   while (!finished_parsing_options) {
     longopt_index = 0;
-    opt = getopt_long(argc, argv, "+i:o:r:d:h", long_options, &longopt_index);
+    opt = getopt_long(argc, argv, "+i:o:r:d:b:t:C:S:W:H:F:A:I:R:D:V:G:M:h", long_options, &longopt_index);
 
     switch (opt) {
       case 'd':;
@@ -77,6 +158,145 @@ bool parse_cmd_args(int argc, char** argv) {
 
         break;
 
+      case 'b':;
+        unsigned long long budget_us;
+
+        ok = sscanf(optarg, "%llu", &budget_us);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --task-budget passed.\n");
+          return false;
+        }
+
+        myEmbedderOptions.task_budget_us = budget_us;
+
+        break;
+
+      case 't':
+        if (strcmp(optarg, "platform") == 0) {
+          myEmbedderOptions.thread_topology = ThreadTopology::kPlatform;
+        } else if (strcmp(optarg, "engine") == 0) {
+          myEmbedderOptions.thread_topology = ThreadTopology::kEngine;
+        } else if (strcmp(optarg, "raster") == 0) {
+          myEmbedderOptions.thread_topology = ThreadTopology::kRaster;
+        } else {
+          LOG_ERROR(stderr, "ERROR: Invalid argument for --threads passed.\n");
+          return false;
+        }
+        break;
+
+      case 'C':
+        ok = sscanf(optarg, "%d", &myEmbedderOptions.raster_cpu);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --raster-cpu passed.\n");
+          return false;
+        }
+        break;
+
+      case 'S':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.stats_interval_s);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --stats-interval passed.\n");
+          return false;
+        }
+        break;
+
+      case 'W':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.watchdog_ms);
+        if (ok != 1) {
+          LOG_ERROR(stderr, "ERROR: Invalid argument for --watchdog passed.\n");
+          return false;
+        }
+        break;
+
+      case 'H':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.hidden_timeout_ms);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --hidden-timeout passed.\n");
+          return false;
+        }
+        break;
+
+      case 'F':
+        if (strcmp(optarg, "native") == 0) {
+          myEmbedderOptions.max_fps = 0;
+          break;
+        }
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.max_fps);
+        if (ok != 1) {
+          LOG_ERROR(stderr, "ERROR: Invalid argument for --fps passed.\n");
+          return false;
+        }
+        break;
+
+      case 'A':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.idle_after_frames);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --idle-after passed.\n");
+          return false;
+        }
+        break;
+
+      case 'I':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.idle_fps);
+        if (ok != 1) {
+          LOG_ERROR(stderr, "ERROR: Invalid argument for --idle-fps passed.\n");
+          return false;
+        }
+        break;
+
+      case 'R':
+        ok = sscanf(optarg, "%lf", &myEmbedderOptions.render_scale);
+        if (ok != 1 || myEmbedderOptions.render_scale <= 0 ||
+            myEmbedderOptions.render_scale > 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --render-scale passed.\n");
+          return false;
+        }
+        break;
+
+      case 'D':
+        ok = sscanf(optarg, "%lf", &myEmbedderOptions.min_render_scale);
+        if (ok != 1 || myEmbedderOptions.min_render_scale <= 0 ||
+            myEmbedderOptions.min_render_scale > 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --dynamic-render-scale "
+                    "passed.\n");
+          return false;
+        }
+        break;
+
+      case 'V':
+        ok = sscanf(optarg, "%d", &myEmbedderOptions.swap_interval);
+        if (ok != 1 || myEmbedderOptions.swap_interval < 0) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --swap-interval passed.\n");
+          return false;
+        }
+        break;
+
+      case 'G':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.gpu_max_frames_behind);
+        if (ok != 1) {
+          LOG_ERROR(stderr,
+                    "ERROR: Invalid argument for --gpu-max-behind passed.\n");
+          return false;
+        }
+        break;
+
+      case 'M':
+        ok = sscanf(optarg, "%u", &myEmbedderOptions.backing_store_budget_mb);
+        if (ok != 1) {
+          LOG_ERROR(stderr, "ERROR: Invalid argument for "
+                            "--backing-store-budget passed.\n");
+          return false;
+        }
+        break;
+
       case 'h':
         PrintUsage();
         return false;
@@ -103,6 +323,16 @@ bool parse_cmd_args(int argc, char** argv) {
 
   myWlFlutter.asset_bundle_path = strdup(argv[optind]);
   myWlFlutter.runtime_mode = (flutter_runtime_mode)runtime_mode_int;
+  if (check_threads_int) {
+    ThreadChecker::set_assertions_enabled(true);
+  }
+  myEmbedderOptions.input_thread = input_thread_int;
+  myEmbedderOptions.vsync = !disable_vsync_int;
+  myEmbedderOptions.partial_repaint = !disable_partial_repaint_int;
+  myEmbedderOptions.translucent = translucent_int;
+  myEmbedderOptions.swap_thread = swap_thread_int;
+  myEmbedderOptions.tearing = tearing_int;
+  myEmbedderOptions.compositor = compositor_int;
 
   argv[optind] = argv[0];
   myWlFlutter.engine_argc = argc - optind;
@@ -202,20 +432,31 @@ static bool Main(int argc, char *argv[]) {
 
   FLWAY_LOG << " current application view width: " << kWidth << ", height: " <<  kHeight << std::endl;
 
-  WaylandDisplay display(kWidth, kHeight);
+  WaylandDisplay display(kWidth, kHeight, myEmbedderOptions);
 
   if (!display.IsValid()) {
     FLWAY_ERR << "Wayland display was not valid." << std::endl;
     return false;
   }
+
+  // The display settled this for itself in SetupEGL(), the application
+  // still has to hear it.
+  if (myEmbedderOptions.compositor && !display.HasLayerCompositor()) {
+    FLWAY_ERR << "No layer compositor, rendering into the window."
+              << std::endl;
+    myEmbedderOptions.compositor = false;
+  }
 	
-  FlutterApplication application(asset_bundle_path, display);
+  FlutterApplication application(asset_bundle_path, display,
+                                 myEmbedderOptions);
   if (!application.IsValid()) {
     FLWAY_ERR << "Flutter application was not valid." << std::endl;
     return false;
   }
 
-  if (!application.SetWindowSize(kWidth, kHeight)) {
+  display.RegisterPlatformMessageHandlers(&application);
+
+  if (!display.SendWindowMetrics()) {
     FLWAY_ERR << "Could not update Flutter application size." << std::endl;
     return false;
   }
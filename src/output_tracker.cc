@@ -0,0 +1,204 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "output_tracker.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "log.h"
+
+namespace flutter {
+
+#define OUTPUT reinterpret_cast<Output*>(data)
+
+const wl_output_listener OutputTracker::kOutputListener = {
+    .geometry = [](void* data,
+                   wl_output* wl_output,
+                   int x,
+                   int y,
+                   int physical_width,
+                   int physical_height,
+                   int subpixel,
+                   const char* make,
+                   const char* model,
+                   int transform) -> void {
+      LOG_INFO("  output listener display_handle_geometry corner:(%d,%d) "
+               "size:(%d %d) make:%s model:%s transform:%d\n",
+               x, y, physical_width, physical_height, make, model, transform);
+    },
+    .mode = [](void* data,
+               wl_output* wl_output,
+               uint32_t flags,
+               int width,
+               int height,
+               int refresh) -> void {
+      LOG_INFO("  output listener display_handle_mode flags:0x%x "
+               "size:(%d,%d) refresh:%d mHz\n",
+               flags, width, height, refresh);
+      if (!(flags & WL_OUTPUT_MODE_CURRENT)) {
+        return;
+      }
+
+      Output* info = OUTPUT;
+      info->width = width;
+      info->height = height;
+      info->refresh_mhz = refresh;
+      info->changed = true;
+
+      // Version 1 outputs send no done event.
+      if (wl_proxy_get_version(reinterpret_cast<wl_proxy*>(wl_output)) < 2) {
+        info->tracker->OnOutputChanged(info);
+      }
+    },
+    .done = [](void* data, wl_output* wl_output) -> void {
+      LOG_INFO("  output done callback\n");
+      Output* info = OUTPUT;
+      if (info->changed) {
+        info->tracker->OnOutputChanged(info);
+      }
+    },
+    .scale = [](void* data, wl_output* wl_output, int32_t factor) -> void {
+      LOG_INFO("  output scale callback factor:%d\n", factor);
+      OUTPUT->scale = factor;
+    },
+};
+
+#undef OUTPUT
+
+OutputTracker::OutputTracker(RefreshCallback on_refresh,
+                             ChangedCallback on_changed)
+    : on_refresh_(std::move(on_refresh)), on_changed_(std::move(on_changed)) {}
+
+OutputTracker::~OutputTracker() {
+  for (const auto& info : outputs_) {
+    wl_output_destroy(info->output);
+  }
+}
+
+void OutputTracker::Add(wl_registry* registry,
+                        uint32_t name,
+                        uint32_t version) {
+  std::unique_ptr<Output> info(new Output());
+  info->tracker = this;
+  info->name = name;
+  info->output = static_cast<wl_output*>(wl_registry_bind(
+      registry, name, &wl_output_interface, std::min(version, 2u)));
+  wl_output_add_listener(info->output, &kOutputListener, info.get());
+  if (!primary_) {
+    primary_ = info->output;
+  }
+  outputs_.push_back(std::move(info));
+}
+
+bool OutputTracker::Remove(uint32_t name) {
+  for (auto it = outputs_.begin(); it != outputs_.end(); ++it) {
+    if ((*it)->name != name) {
+      continue;
+    }
+    LOG_INFO("  wl_output %u removed\n", name);
+    const Output* pacing = PacingOutput();
+    surface_outputs_.erase(std::remove(surface_outputs_.begin(),
+                                       surface_outputs_.end(), it->get()),
+                           surface_outputs_.end());
+    if (primary_ == (*it)->output) {
+      primary_ = nullptr;
+    }
+    const bool was_pacing = pacing == it->get();
+    wl_output_destroy((*it)->output);
+    outputs_.erase(it);
+    if (!primary_ && !outputs_.empty()) {
+      primary_ = outputs_.front()->output;
+    }
+    if (was_pacing && PacingOutput()) {
+      UpdateRefresh(PacingOutput());
+    }
+    on_changed_();
+    return true;
+  }
+  return false;
+}
+
+void OutputTracker::OnSurfaceEnter(wl_output* output) {
+  for (const auto& info : outputs_) {
+    if (info->output == output) {
+      surface_outputs_.erase(std::remove(surface_outputs_.begin(),
+                                         surface_outputs_.end(), info.get()),
+                             surface_outputs_.end());
+      surface_outputs_.push_back(info.get());
+      UpdateRefresh(info.get());
+      return;
+    }
+  }
+}
+
+void OutputTracker::OnSurfaceLeave(wl_output* output) {
+  const Output* pacing = PacingOutput();
+  surface_outputs_.erase(
+      std::remove_if(surface_outputs_.begin(), surface_outputs_.end(),
+                     [output](const Output* info) {
+                       return info->output == output;
+                     }),
+      surface_outputs_.end());
+  // Paced by whatever it is still on, or else by the primary output.
+  const Output* next = PacingOutput();
+  if (next && next != pacing) {
+    UpdateRefresh(next);
+  }
+}
+
+std::vector<FlutterEngineDisplay> OutputTracker::Displays() const {
+  std::vector<FlutterEngineDisplay> displays;
+  for (const auto& info : outputs_) {
+    if (info->refresh_mhz <= 0) {
+      continue;
+    }
+    FlutterEngineDisplay display = {};
+    display.struct_size = sizeof(FlutterEngineDisplay);
+    display.display_id = info->name;
+    display.refresh_rate = info->refresh_mhz / 1000.0;
+    displays.push_back(display);
+  }
+  for (auto& display : displays) {
+    display.single_display = displays.size() == 1;
+  }
+  return displays;
+}
+
+void OutputTracker::OnOutputChanged(Output* info) {
+  info->changed = false;
+  LOG_INFO("Output %u: %dx%d, scale %d, %d.%03d Hz\n", info->name,
+           info->width, info->height, info->scale, info->refresh_mhz / 1000,
+           info->refresh_mhz % 1000);
+
+  if (info == PacingOutput()) {
+    UpdateRefresh(info);
+  }
+  on_changed_();
+}
+
+OutputTracker::Output* OutputTracker::PacingOutput() const {
+  if (!surface_outputs_.empty()) {
+    return surface_outputs_.back();
+  }
+  for (const auto& info : outputs_) {
+    if (info->output == primary_) {
+      return info.get();
+    }
+  }
+  return nullptr;
+}
+
+void OutputTracker::UpdateRefresh(const Output* info) {
+  if (info->refresh_mhz > 0) {
+    on_refresh_(info->refresh_mhz);
+  }
+}
+
+}  // namespace flutter
@@ -0,0 +1,93 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_OUTPUT_TRACKER_H_
+#define EMBEDDER_FLUTTER_OUTPUT_TRACKER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <flutter_embedder.h>
+#include <wayland-client.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The wl_output globals and their current modes, reported to the engine as
+// its displays, and which of them paces the surface: of those it is on, the
+// one it entered last, or else the first one announced. Platform thread
+// only.
+class OutputTracker {
+ public:
+  // |refresh_mhz| is the pacing output's refresh rate, told whenever it or
+  // its mode changes. Never zero.
+  using RefreshCallback = std::function<void(int32_t refresh_mhz)>;
+  // The displays changed, see Displays().
+  using ChangedCallback = std::function<void()>;
+
+  OutputTracker(RefreshCallback on_refresh, ChangedCallback on_changed);
+
+  ~OutputTracker();
+
+  // Binds the wl_output global |name|.
+  void Add(wl_registry* registry, uint32_t name, uint32_t version);
+
+  // Returns false if global |name| is not an output.
+  bool Remove(uint32_t name);
+
+  void OnSurfaceEnter(wl_output* output);
+
+  void OnSurfaceLeave(wl_output* output);
+
+  // The first output announced, which the surface is expected on. Null
+  // until there is one.
+  wl_output* primary() const { return primary_; }
+
+  // Every output with a known mode, the registry name as display id.
+  std::vector<FlutterEngineDisplay> Displays() const;
+
+ private:
+  struct Output {
+    OutputTracker* tracker = nullptr;
+    wl_output* output = nullptr;
+    uint32_t name = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t refresh_mhz = 0;
+    int32_t scale = 1;
+    // A mode event arrived that the next done event applies.
+    bool changed = false;
+  };
+
+  static const wl_output_listener kOutputListener;
+
+  RefreshCallback on_refresh_;
+  ChangedCallback on_changed_;
+  std::vector<std::unique_ptr<Output>> outputs_;
+  wl_output* primary_ = nullptr;
+  // The outputs the surface is on, in the order it entered them.
+  std::vector<Output*> surface_outputs_;
+
+  // Null while there is no output at all.
+  Output* PacingOutput() const;
+
+  void OnOutputChanged(Output* info);
+
+  void UpdateRefresh(const Output* info);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(OutputTracker);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_OUTPUT_TRACKER_H_
@@ -72,6 +72,11 @@ void PlatformChannel::SetEngine(FlutterEngine engine) {
   engine_ = engine;
 }
 
+void PlatformChannel::SetMessageHandler(const std::string& channel,
+                                        MessageHandler handler) {
+  platform_message_handlers_[channel] = std::move(handler);
+}
+
 void PlatformChannel::PlatformMessageCallback(
     const FlutterPlatformMessage* message) {
   // Find the handler for the channel; if there isn't one, report the failure.
@@ -20,14 +20,19 @@ namespace flutter {
 
 class PlatformChannel {
  public:
+  using MessageHandler = std::function<void(const FlutterPlatformMessage*)>;
+
   PlatformChannel();
   void PlatformMessageCallback(const FlutterPlatformMessage* message);
   void SetEngine(FlutterEngine engine);
 
+  // Routes messages on |channel| to |handler|, replacing the built in one if
+  // there is any. The handler has to answer the message's response handle.
+  void SetMessageHandler(const std::string& channel, MessageHandler handler);
+
  private:
   FlutterEngine engine_;
-  std::map<std::string, std::function<void(const FlutterPlatformMessage*)>>
-      platform_message_handlers_;
+  std::map<std::string, MessageHandler> platform_message_handlers_;
       
   void OnAccessibilityChannelPlatformMessage(const FlutterPlatformMessage*);
   void OnFlutterPlatformChannelPlatformMessage(const FlutterPlatformMessage*);
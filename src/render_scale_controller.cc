@@ -0,0 +1,79 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "render_scale_controller.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace flutter {
+
+constexpr size_t RenderScaleController::kWindow;
+
+namespace {
+
+// Scale change per decision.
+constexpr double kStep = 0.1;
+
+// Percentile of the window compared against the budget, so a single hiccup
+// does not cost resolution.
+constexpr size_t kPercentile = 90;
+
+// Overrun above this share of the budget, headroom below that one. The gap
+// keeps the scale from flipping between two steps.
+constexpr uint64_t kSlowPercent = 90;
+constexpr uint64_t kFastPercent = 60;
+
+}  // namespace
+
+RenderScaleController::RenderScaleController(double min_scale,
+                                             double max_scale)
+    : min_scale_(std::min(min_scale, max_scale)),
+      max_scale_(max_scale),
+      scale_(max_scale) {}
+
+bool RenderScaleController::Record(uint64_t render_time, uint64_t budget) {
+  if (budget == 0) {
+    return false;
+  }
+  window_[window_size_++] = render_time;
+  if (window_size_ < kWindow) {
+    return false;
+  }
+  window_size_ = 0;
+
+  const size_t rank = kWindow * kPercentile / 100;
+  std::nth_element(window_, window_ + rank, window_ + kWindow);
+  const uint64_t slow = window_[rank];
+
+  double scale = scale_;
+  if (slow * 100 > budget * kSlowPercent) {
+    fast_windows_ = 0;
+    scale = std::max(min_scale_, scale_ - kStep);
+  } else if (slow * 100 < budget * kFastPercent) {
+    if (++fast_windows_ >= 2) {
+      fast_windows_ = 0;
+      scale = std::min(max_scale_, scale_ + kStep);
+    }
+  } else {
+    fast_windows_ = 0;
+  }
+
+  // Stay on the grid of steps, repeated additions drift.
+  scale = std::min(max_scale_,
+                   std::max(min_scale_, round(scale / kStep) * kStep));
+  if (scale == scale_) {
+    return false;
+  }
+  scale_ = scale;
+  return true;
+}
+
+}  // namespace flutter
@@ -0,0 +1,52 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_RENDER_SCALE_CONTROLLER_H_
+#define EMBEDDER_FLUTTER_RENDER_SCALE_CONTROLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Picks the render scale from how long frames take to render compared to the
+// frame budget. Decisions are made once per window of frames: a window whose
+// slowest frames overrun the budget steps the scale down, two windows in a
+// row with plenty of headroom step it back up. Not thread safe.
+class RenderScaleController {
+ public:
+  // Frames per decision.
+  static constexpr size_t kWindow = 30;
+
+  RenderScaleController(double min_scale, double max_scale);
+
+  // |render_time| is vsync to present of one frame, |budget| the time
+  // between frames. Returns true if scale() changed.
+  bool Record(uint64_t render_time, uint64_t budget);
+
+  double scale() const { return scale_; }
+
+ private:
+  double min_scale_;
+  double max_scale_;
+  double scale_;
+
+  uint64_t window_[kWindow];
+  size_t window_size_ = 0;
+  // Windows with headroom in a row.
+  int fast_windows_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(RenderScaleController);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_RENDER_SCALE_CONTROLLER_H_
@@ -0,0 +1,68 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_RING_BUFFER_H_
+#define EMBEDDER_FLUTTER_RING_BUFFER_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Bounded lock free queue for exactly one producer and one consumer thread.
+template <typename T, size_t N>
+class RingBuffer {
+ public:
+  static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+  RingBuffer() : read_(0), write_(0) {}
+
+  // Producer side. Returns false if the buffer is full.
+  bool Push(const T& item) {
+    const size_t write = write_.load(std::memory_order_relaxed);
+    if (write - read_.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    items_[write & (N - 1)] = item;
+    write_.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side.
+  bool empty() const {
+    return read_.load(std::memory_order_relaxed) ==
+           write_.load(std::memory_order_acquire);
+  }
+
+  // Consumer side. Returns false if the buffer is empty.
+  bool Pop(T* item) {
+    const size_t read = read_.load(std::memory_order_relaxed);
+    if (read == write_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = items_[read & (N - 1)];
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  T items_[N];
+  // Kept on separate cache lines so producer and consumer do not contend.
+  alignas(64) std::atomic<size_t> read_;
+  alignas(64) std::atomic<size_t> write_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_RING_BUFFER_H_
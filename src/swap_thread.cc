@@ -0,0 +1,130 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "swap_thread.h"
+
+#include <pthread.h>
+
+#include <utility>
+
+#include <GLES2/gl2.h>
+
+#include <flutter_embedder.h>
+
+#include "log.h"
+
+namespace flutter {
+
+SwapThread::SwapThread(EGLDisplay display,
+                       EGLSurface surface,
+                       EGLContext context,
+                       const EGLSyncFunctions& sync)
+    : display_(display), surface_(surface), context_(context), sync_(sync) {
+  thread_ = std::thread(&SwapThread::Run, this);
+  pthread_setname_np(thread_.native_handle(), "flutter.swap");
+  LOG_INFO("Swapping buffers on a dedicated thread\n");
+}
+
+SwapThread::~SwapThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+  }
+  thread_.join();
+}
+
+bool SwapThread::Post(EGLContext render_context, SwapCallback swap) {
+  // The swap thread's context does not see the render context's commands
+  // in order, the fence tells it when the frame is done. Flushed so that
+  // the fence can signal at all.
+  EGLSyncKHR fence = sync_.create(display_, EGL_SYNC_FENCE_KHR, nullptr);
+  if (fence == EGL_NO_SYNC_KHR) {
+    FLWAY_ERR << "Could not fence the frame for the swap thread: 0x"
+              << std::hex << eglGetError() << std::dec << std::endl;
+    return false;
+  }
+  glFlush();
+  if (eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                     render_context) != EGL_TRUE) {
+    FLWAY_ERR << "Could not release the surface for the swap thread: 0x"
+              << std::hex << eglGetError() << std::dec << std::endl;
+    sync_.destroy(display_, fence);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  fence_ = fence;
+  swap_ = std::move(swap);
+  pending_ = true;
+  cv_.notify_all();
+  return true;
+}
+
+void SwapThread::Wait() {
+  const uint64_t start = FlutterEngineGetCurrentTime();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!pending_) {
+      return;
+    }
+    cv_.wait(lock, [this] { return !pending_; });
+  }
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_.Record(FlutterEngineGetCurrentTime() - start);
+}
+
+void SwapThread::PrintSummary(FILE* out) {
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_.PrintSummary(out, "  raster thread waiting for the swap", 1000,
+                     "us");
+}
+
+void SwapThread::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return pending_ || stop_; });
+    if (!pending_) {
+      return;
+    }
+    EGLSyncKHR fence = fence_;
+    SwapCallback swap = std::move(swap_);
+    fence_ = EGL_NO_SYNC_KHR;
+    lock.unlock();
+
+    const bool current =
+        eglMakeCurrent(display_, surface_, surface_, context_) == EGL_TRUE;
+    if (current) {
+      // A server side wait only orders this context behind the frame, a
+      // client side one blocks this thread until the GPU is done with it.
+      EGLint waited =
+          sync_.wait ? sync_.wait(display_, fence, 0)
+                     : sync_.client_wait(display_, fence, 0, EGL_FOREVER_KHR);
+      if (waited == EGL_FALSE) {
+        FLWAY_ERR << "Swap thread could not wait for the frame: 0x"
+                  << std::hex << eglGetError() << std::dec << std::endl;
+      }
+    } else {
+      FLWAY_ERR << "Swap thread could not make the surface current: 0x"
+                << std::hex << eglGetError() << std::dec << std::endl;
+    }
+    sync_.destroy(display_, fence);
+    swap(current);
+    if (current) {
+      eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                     EGL_NO_CONTEXT);
+    }
+
+    lock.lock();
+    pending_ = false;
+    cv_.notify_all();
+  }
+}
+
+}  // namespace flutter
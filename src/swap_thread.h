@@ -0,0 +1,85 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_SWAP_THREAD_H_
+#define EMBEDDER_FLUTTER_SWAP_THREAD_H_
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gpu_fences.h"
+#include "histogram.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Swaps buffers off the raster thread, see EmbedderOptions::swap_thread.
+// Post() fences the frame in the raster thread's context, releases the
+// surface and hands the swap over; the raster thread's next make current
+// waits for it with Wait(). The swap runs with |context| current on
+// |surface|, behind the fence: a server side wait with EGL_KHR_wait_sync,
+// a client side one otherwise. One swap is in flight at a time.
+class SwapThread {
+ public:
+  // Runs on the swap thread. |current| is false if the surface could not be
+  // made current, the swap is then to be undone rather than done.
+  using SwapCallback = std::function<void(bool current)>;
+
+  // The display needs EGL_KHR_surfaceless_context and |sync| fence syncs.
+  SwapThread(EGLDisplay display,
+             EGLSurface surface,
+             EGLContext context,
+             const EGLSyncFunctions& sync);
+
+  // Runs the swap still pending, then joins.
+  ~SwapThread();
+
+  // Raster thread, |render_context| current on the surface with the frame
+  // drawn. Returns false, leaving the context current on the surface, if
+  // the swap could not be handed over; the caller then swaps itself.
+  bool Post(EGLContext render_context, SwapCallback swap);
+
+  // Blocks until the swap posted last is done with the surface.
+  void Wait();
+
+  // How long Wait() blocked.
+  void PrintSummary(FILE* out);
+
+ private:
+  EGLDisplay display_;
+  EGLSurface surface_;
+  EGLContext context_;
+  const EGLSyncFunctions sync_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool pending_ = false;
+  bool stop_ = false;
+  EGLSyncKHR fence_ = EGL_NO_SYNC_KHR;
+  SwapCallback swap_;
+
+  std::mutex wait_mutex_;
+  Histogram wait_;
+
+  void Run();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SwapThread);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_SWAP_THREAD_H_
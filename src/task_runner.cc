@@ -0,0 +1,151 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "task_runner.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "log.h"
+
+namespace flutter {
+
+TaskRunner::TaskRunner() : posted_tasks_(nullptr) {
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    FLWAY_ERR << "Could not create task runner eventfd: " << strerror(errno)
+              << std::endl;
+  }
+}
+
+TaskRunner::~TaskRunner() {
+  PostedTask* posted = posted_tasks_.exchange(nullptr);
+  while (posted != nullptr) {
+    PostedTask* next = posted->next;
+    delete posted;
+    posted = next;
+  }
+
+  if (wakeup_fd_ >= 0) {
+    close(wakeup_fd_);
+  }
+}
+
+bool TaskRunner::IsValid() const {
+  return wakeup_fd_ >= 0;
+}
+
+void TaskRunner::PostTask(FlutterTask task, uint64_t target_time) {
+  PostedTask* posted = new PostedTask{task, target_time, nullptr};
+
+  posted->next = posted_tasks_.load(std::memory_order_relaxed);
+  while (!posted_tasks_.compare_exchange_weak(posted->next, posted,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+  }
+
+  // Only the producer that makes the stack non empty has to wake the
+  // consumer; everybody else piggybacks on that wakeup.
+  if (posted->next == nullptr) {
+    uint64_t value = 1;
+    if (write(wakeup_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+      LOG_ERROR(stderr, "Could not signal task runner: %s\n", strerror(errno));
+    }
+  }
+}
+
+void TaskRunner::DrainPostedTasks() {
+  FLWAY_CHECK_THREAD(owner_, "TaskRunner::DrainPostedTasks");
+
+  // Clear the signal before taking the stack so that a task posted after the
+  // exchange below signals again.
+  uint64_t value;
+  read(wakeup_fd_, &value, sizeof(value));
+
+  PostedTask* posted = posted_tasks_.exchange(nullptr, std::memory_order_acquire);
+
+  // The stack is LIFO, reverse it to keep the posting order.
+  PostedTask* ordered = nullptr;
+  while (posted != nullptr) {
+    PostedTask* next = posted->next;
+    posted->next = ordered;
+    ordered = posted;
+    posted = next;
+  }
+
+  if (ordered != nullptr) {
+    // The wheel range is relative to its current position.
+    wheel_.Advance(FlutterEngineGetCurrentTime());
+  }
+
+  while (ordered != nullptr) {
+    PostedTask* next = ordered->next;
+    if (!wheel_.Insert(ordered->task, ordered->target_time)) {
+      far_tasks_.push_back(QueuedTask{ordered->target_time, next_sequence_++,
+                                      ordered->task});
+      std::push_heap(far_tasks_.begin(), far_tasks_.end(),
+                     CompareQueuedTask());
+    }
+    delete ordered;
+    ordered = next;
+  }
+}
+
+uint64_t TaskRunner::NextDeadline() const {
+  uint64_t deadline = wheel_.NextDeadline();
+  if (!far_tasks_.empty()) {
+    // Zero means "no deadline" to callers; a task targeted at the epoch is
+    // just overdue.
+    uint64_t far_deadline = std::max<uint64_t>(far_tasks_.front().target_time, 1);
+    if (deadline == 0 || far_deadline < deadline) {
+      deadline = far_deadline;
+    }
+  }
+  return deadline;
+}
+
+bool TaskRunner::PopExpiredTask(uint64_t now,
+                                FlutterTask* task,
+                                uint64_t* target_time) {
+  // A task filed in the heap while it was out of the wheel's range can come
+  // due before tasks posted later into the wheel, so take whichever head is
+  // earlier. Ties go to the wheel.
+  uint64_t wheel_target_time;
+  const bool wheel_due = wheel_.PeekExpired(now, &wheel_target_time);
+  const bool far_due =
+      !far_tasks_.empty() && far_tasks_.front().target_time <= now;
+  if (!far_due ||
+      (wheel_due && wheel_target_time <= far_tasks_.front().target_time)) {
+    return wheel_due && wheel_.PopExpired(now, task, target_time);
+  }
+
+  *task = far_tasks_.front().task;
+  if (target_time) {
+    *target_time = far_tasks_.front().target_time;
+  }
+  std::pop_heap(far_tasks_.begin(), far_tasks_.end(), CompareQueuedTask());
+  far_tasks_.pop_back();
+  return true;
+}
+
+size_t TaskRunner::CountExpiredTasks(uint64_t now) const {
+  size_t count = wheel_.expired_count();
+  for (const auto& queued : far_tasks_) {
+    if (queued.target_time <= now) {
+      count++;
+    }
+  }
+  return count;
+}
+
+}  // namespace flutter
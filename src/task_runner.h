@@ -0,0 +1,112 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_TASK_RUNNER_H_
+#define EMBEDDER_FLUTTER_TASK_RUNNER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include <flutter_embedder.h>
+
+#include "macros.h"
+#include "thread_checker.h"
+#include "timer_wheel.h"
+
+namespace flutter {
+
+// Backing store for a FlutterTaskRunnerDescription.
+//
+// The engine posts tasks from its UI, raster and IO threads, so PostTask() is
+// lock free: tasks are pushed onto an intrusive multi-producer stack and the
+// first producer to find it empty signals |wakeup_fd()|. The thread that owns
+// the runner drains that stack into a timer wheel which only it touches, so
+// the consumer side needs no synchronization either. Tasks too far out for the
+// wheel go to a deadline ordered heap.
+class TaskRunner {
+ public:
+  TaskRunner();
+
+  ~TaskRunner();
+
+  bool IsValid() const;
+
+  // Thread safe.
+  void PostTask(FlutterTask task, uint64_t target_time);
+
+  // Becomes readable when tasks were posted since the last DrainPostedTasks().
+  int wakeup_fd() const { return wakeup_fd_; }
+
+  // Makes the calling thread the one that runs the tasks.
+  void BindToCurrentThread() { owner_.BindToCurrentThread(); }
+
+  // Thread safe. Backs runs_task_on_current_thread_callback.
+  bool RunsTasksOnCurrentThread() const {
+    return owner_.IsBoundToCurrentThread();
+  }
+
+  // The remaining methods must only be called on the owning thread.
+
+  // Moves every posted task into the timer wheel or the deadline heap.
+  void DrainPostedTasks();
+
+  // Target time of the earliest task, or zero if there is none.
+  uint64_t NextDeadline() const;
+
+  // Pops the earliest task if its target time is not after |now|.
+  // |target_time| may be null.
+  bool PopExpiredTask(uint64_t now, FlutterTask* task, uint64_t* target_time);
+
+  // Number of queued tasks whose target time is not after |now|, which must
+  // not be later than the last PopExpiredTask(). Linear in the number of far
+  // future tasks, meant for bookkeeping off the fast path.
+  size_t CountExpiredTasks(uint64_t now) const;
+
+  size_t size() const { return wheel_.size() + far_tasks_.size(); }
+
+ private:
+  struct PostedTask {
+    FlutterTask task;
+    uint64_t target_time;
+    PostedTask* next;
+  };
+
+  struct QueuedTask {
+    uint64_t target_time;
+    // Keeps tasks with the same target time in the order they were posted.
+    uint64_t sequence;
+    FlutterTask task;
+  };
+
+  class CompareQueuedTask {
+   public:
+    bool operator()(const QueuedTask& a, const QueuedTask& b) const {
+      if (a.target_time != b.target_time) {
+        return a.target_time > b.target_time;
+      }
+      return a.sequence > b.sequence;
+    }
+  };
+
+  int wakeup_fd_ = -1;
+  ThreadChecker owner_;
+  std::atomic<PostedTask*> posted_tasks_;
+  uint64_t next_sequence_ = 0;
+  TimerWheel wheel_;
+  // Binary heap ordered by CompareQueuedTask.
+  std::vector<QueuedTask> far_tasks_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TaskRunner);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_TASK_RUNNER_H_
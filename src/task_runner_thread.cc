@@ -0,0 +1,91 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "task_runner_thread.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/epoll.h>
+
+#include "log.h"
+
+namespace flutter {
+
+TaskRunnerThread::TaskRunnerThread(const std::string& name,
+                                   int cpu,
+                                   TaskCallback run_task)
+    : name_(name), run_task_(std::move(run_task)), running_(false) {
+  if (!loop_.IsValid() || !task_runner_.IsValid()) {
+    FLWAY_ERR << "Could not create the " << name_ << " task runner."
+              << std::endl;
+    return;
+  }
+
+  if (!loop_.AddFd(task_runner_.wakeup_fd(), EPOLLIN, [this](uint32_t events) {
+        task_runner_.DrainPostedTasks();
+      })) {
+    return;
+  }
+
+  running_ = true;
+  thread_ = std::thread(&TaskRunnerThread::Run, this);
+
+  // Thread names are limited to 15 characters.
+  pthread_setname_np(thread_.native_handle(), name_.substr(0, 15).c_str());
+
+  if (cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int error =
+        pthread_setaffinity_np(thread_.native_handle(), sizeof(cpus), &cpus);
+    if (error != 0) {
+      LOG_ERROR(stderr, "Could not pin %s thread to cpu %d: %s\n",
+                name_.c_str(), cpu, strerror(error));
+    }
+  }
+
+  LOG_INFO("Started %s task runner thread\n", name_.c_str());
+}
+
+TaskRunnerThread::~TaskRunnerThread() {
+  if (thread_.joinable()) {
+    running_ = false;
+    loop_.Wakeup();
+    thread_.join();
+  }
+}
+
+bool TaskRunnerThread::IsValid() const {
+  return thread_.joinable();
+}
+
+void TaskRunnerThread::PostTask(FlutterTask task, uint64_t target_time) {
+  task_runner_.PostTask(task, target_time);
+}
+
+void TaskRunnerThread::Run() {
+  task_runner_.BindToCurrentThread();
+
+  while (running_) {
+    loop_.SetDeadline(task_runner_.NextDeadline());
+    if (loop_.Poll(-1) < 0) {
+      break;
+    }
+
+    const uint64_t now = FlutterEngineGetCurrentTime();
+    FlutterTask task;
+    while (running_ && task_runner_.PopExpiredTask(now, &task, nullptr)) {
+      run_task_(&task);
+    }
+  }
+}
+
+}  // namespace flutter
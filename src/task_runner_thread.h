@@ -0,0 +1,65 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_TASK_RUNNER_THREAD_H_
+#define EMBEDDER_FLUTTER_TASK_RUNNER_THREAD_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <flutter_embedder.h>
+
+#include "event_loop.h"
+#include "macros.h"
+#include "task_runner.h"
+
+namespace flutter {
+
+// A thread owned by the embedder that serves one custom engine task runner,
+// e.g. the render task runner. Unlike the platform thread it has nothing to
+// do besides running engine tasks, so it drains every due task at once.
+class TaskRunnerThread {
+ public:
+  using TaskCallback = std::function<void(const FlutterTask* task)>;
+
+  // Starts the thread. |cpu| pins it to one CPU unless negative.
+  TaskRunnerThread(const std::string& name, int cpu, TaskCallback run_task);
+
+  // Stops and joins the thread. Tasks still queued are dropped, so the
+  // engine has to be shut down first.
+  ~TaskRunnerThread();
+
+  bool IsValid() const;
+
+  // Thread safe.
+  void PostTask(FlutterTask task, uint64_t target_time);
+
+  // Thread safe.
+  bool RunsTasksOnCurrentThread() const {
+    return task_runner_.RunsTasksOnCurrentThread();
+  }
+
+ private:
+  const std::string name_;
+  const TaskCallback run_task_;
+  EventLoop loop_;
+  TaskRunner task_runner_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+
+  void Run();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TaskRunnerThread);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_TASK_RUNNER_THREAD_H_
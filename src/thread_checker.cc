@@ -0,0 +1,20 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "thread_checker.h"
+
+namespace flutter {
+
+#ifdef NDEBUG
+bool ThreadChecker::assertions_enabled_ = false;
+#else
+bool ThreadChecker::assertions_enabled_ = true;
+#endif
+
+}  // namespace flutter
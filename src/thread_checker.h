@@ -0,0 +1,72 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_THREAD_CHECKER_H_
+#define EMBEDDER_FLUTTER_THREAD_CHECKER_H_
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <thread>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Remembers the thread an object belongs to. It binds to the first thread
+// that asks, or explicitly through BindToCurrentThread().
+class ThreadChecker {
+ public:
+  ThreadChecker() : owner_(std::thread::id()) {}
+
+  void BindToCurrentThread() { owner_ = std::this_thread::get_id(); }
+
+  void DetachFromThread() { owner_ = std::thread::id(); }
+
+  // Unlike CalledOnValidThread() this never binds.
+  bool IsBoundToCurrentThread() const {
+    return owner_.load() == std::this_thread::get_id();
+  }
+
+  bool CalledOnValidThread() {
+    std::thread::id current = std::this_thread::get_id();
+    std::thread::id owner = std::thread::id();
+    if (owner_.compare_exchange_strong(owner, current)) {
+      return true;
+    }
+    return owner == current;
+  }
+
+  // Whether FLWAY_CHECK_THREAD asserts. On in debug builds, and in release
+  // builds when asked for on the command line.
+  static bool assertions_enabled() { return assertions_enabled_; }
+
+  static void set_assertions_enabled(bool enabled) {
+    assertions_enabled_ = enabled;
+  }
+
+ private:
+  std::atomic<std::thread::id> owner_;
+  static bool assertions_enabled_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ThreadChecker);
+};
+
+#define FLWAY_CHECK_THREAD(checker, what)                                \
+  do {                                                                   \
+    if (ThreadChecker::assertions_enabled() &&                           \
+        !(checker).CalledOnValidThread()) {                              \
+      FLWAY_ERR << what << " called from the wrong thread." << std::endl; \
+      abort();                                                           \
+    }                                                                    \
+  } while (0)
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_THREAD_CHECKER_H_
@@ -0,0 +1,250 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+static constexpr uint64_t kTickMask = (1ull << TimerWheel::kTickShift) - 1;
+
+// Distance from |start| to the first set bit of a 256 bit slot bitmap,
+// wrapping around, or -1 if no bit is set.
+static int FindOccupiedSlot(const uint64_t* bitmap, unsigned start) {
+  constexpr unsigned kWords = TimerWheel::kSlots / 64;
+  unsigned word = start / 64;
+  uint64_t bits = bitmap[word] & (~0ull << (start % 64));
+
+  for (unsigned i = 0; i <= kWords; i++) {
+    if (bits != 0) {
+      unsigned slot = word * 64 + __builtin_ctzll(bits);
+      return (slot - start) & (TimerWheel::kSlots - 1);
+    }
+    word = (word + 1) % kWords;
+    bits = bitmap[word];
+    if (i == kWords - 1) {
+      // Back at the first word: only the bits below |start| are left.
+      bits &= ~(~0ull << (start % 64));
+    }
+  }
+  return -1;
+}
+
+TimerWheel::TimerWheel() = default;
+
+TimerWheel::~TimerWheel() = default;
+
+uint32_t TimerWheel::AllocateNode(FlutterTask task,
+                                  uint64_t target_time,
+                                  uint64_t expiry_tick) {
+  uint32_t index = free_nodes_;
+  if (index != kNil) {
+    free_nodes_ = nodes_[index].next;
+    nodes_[index] = Node{task, target_time, expiry_tick, kNil};
+  } else {
+    index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{task, target_time, expiry_tick, kNil});
+  }
+  return index;
+}
+
+void TimerWheel::Append(List* list, uint32_t node) {
+  nodes_[node].next = kNil;
+  if (list->tail == kNil) {
+    list->head = node;
+  } else {
+    nodes_[list->tail].next = node;
+  }
+  list->tail = node;
+  list->count++;
+  list->min_tick = std::min(list->min_tick, nodes_[node].expiry_tick);
+}
+
+void TimerWheel::File(uint32_t node) {
+  const uint64_t expiry = nodes_[node].expiry_tick;
+
+  if (expiry < next_tick_) {
+    Append(&expired_, node);
+    return;
+  }
+
+  const uint64_t distance = expiry - next_tick_;
+  for (unsigned level = 0; level < kLevels; level++) {
+    const unsigned shift = level * kSlotBits;
+    if (distance < (1ull << (shift + kSlotBits))) {
+      const unsigned slot = (expiry >> shift) & (kSlots - 1);
+      Append(&slots_[level][slot], node);
+      occupied_[level][slot / 64] |= 1ull << (slot % 64);
+      return;
+    }
+  }
+}
+
+bool TimerWheel::Insert(FlutterTask task, uint64_t target_time) {
+  if (target_time > UINT64_MAX - kTickMask) {
+    return false;
+  }
+
+  // Round up so that a task never runs before its target time.
+  const uint64_t expiry = (target_time + kTickMask) >> kTickShift;
+  if (expiry >= next_tick_ &&
+      expiry - next_tick_ >= (1ull << (kLevels * kSlotBits))) {
+    return false;
+  }
+
+  const uint32_t node = AllocateNode(task, target_time, expiry);
+  if (target_time <= now_) {
+    Append(&expired_, node);
+  } else {
+    File(node);
+  }
+  size_++;
+  return true;
+}
+
+void TimerWheel::Cascade(unsigned level, unsigned slot) {
+  List list = slots_[level][slot];
+  slots_[level][slot] = List();
+  occupied_[level][slot / 64] &= ~(1ull << (slot % 64));
+
+  uint32_t node = list.head;
+  while (node != kNil) {
+    uint32_t next = nodes_[node].next;
+    File(node);
+    node = next;
+  }
+}
+
+void TimerWheel::ProcessTick(uint64_t tick) {
+  next_tick_ = tick;
+
+  // Refill the lower levels first when crossing their boundaries.
+  for (unsigned level = kLevels - 1; level > 0; level--) {
+    const unsigned shift = level * kSlotBits;
+    if ((tick & ((1ull << shift) - 1)) == 0) {
+      Cascade(level, (tick >> shift) & (kSlots - 1));
+    }
+  }
+
+  const unsigned slot = tick & (kSlots - 1);
+  List& list = slots_[0][slot];
+  if (list.head != kNil) {
+    if (expired_.tail == kNil) {
+      expired_.head = list.head;
+    } else {
+      nodes_[expired_.tail].next = list.head;
+    }
+    expired_.tail = list.tail;
+    expired_.count += list.count;
+    list = List();
+    occupied_[0][slot / 64] &= ~(1ull << (slot % 64));
+  }
+
+  next_tick_ = tick + 1;
+}
+
+uint64_t TimerWheel::NextEventTick() const {
+  if (size_ == expired_.count) {
+    return UINT64_MAX;
+  }
+
+  uint64_t next_event = UINT64_MAX;
+  for (unsigned level = 0; level < kLevels; level++) {
+    const unsigned shift = level * kSlotBits;
+    // Level zero slots are visited tick by tick, higher levels on their
+    // boundaries.
+    const uint64_t first_visit =
+        (next_tick_ + (1ull << shift) - 1) >> shift;
+    int distance =
+        FindOccupiedSlot(occupied_[level], first_visit & (kSlots - 1));
+    if (distance >= 0) {
+      next_event = std::min(next_event, (first_visit + distance) << shift);
+    }
+  }
+  return next_event;
+}
+
+void TimerWheel::Advance(uint64_t now) {
+  const uint64_t now_tick = now >> kTickShift;
+  now_ = std::max(now_, now);
+
+  while (true) {
+    uint64_t tick = NextEventTick();
+    if (tick > now_tick) {
+      break;
+    }
+    ProcessTick(tick);
+  }
+
+  next_tick_ = std::max(next_tick_, now_tick + 1);
+}
+
+bool TimerWheel::PeekExpired(uint64_t now, uint64_t* target_time) {
+  if (expired_.count == 0) {
+    Advance(now);
+    if (expired_.count == 0) {
+      return false;
+    }
+  }
+
+  *target_time = nodes_[expired_.head].target_time;
+  return true;
+}
+
+bool TimerWheel::PopExpired(uint64_t now,
+                            FlutterTask* task,
+                            uint64_t* target_time) {
+  uint64_t head_target_time;
+  if (!PeekExpired(now, &head_target_time)) {
+    return false;
+  }
+
+  const uint32_t node = expired_.head;
+  expired_.head = nodes_[node].next;
+  if (expired_.head == kNil) {
+    expired_.tail = kNil;
+  }
+  expired_.count--;
+  size_--;
+
+  *task = nodes_[node].task;
+  if (target_time) {
+    *target_time = nodes_[node].target_time;
+  }
+  nodes_[node].next = free_nodes_;
+  free_nodes_ = node;
+  return true;
+}
+
+uint64_t TimerWheel::NextDeadline() const {
+  if (expired_.count != 0) {
+    return 1;
+  }
+
+  uint64_t next_tick = UINT64_MAX;
+  for (unsigned level = 0; level < kLevels; level++) {
+    const unsigned shift = level * kSlotBits;
+    const uint64_t first_visit =
+        (next_tick_ + (1ull << shift) - 1) >> shift;
+    int distance =
+        FindOccupiedSlot(occupied_[level], first_visit & (kSlots - 1));
+    if (distance >= 0) {
+      const unsigned slot = (first_visit + distance) & (kSlots - 1);
+      next_tick = std::min(next_tick, slots_[level][slot].min_tick);
+    }
+  }
+
+  if (next_tick == UINT64_MAX) {
+    return 0;
+  }
+  return next_tick << kTickShift;
+}
+
+}  // namespace flutter
@@ -0,0 +1,124 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_TIMER_WHEEL_H_
+#define EMBEDDER_FLUTTER_TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <flutter_embedder.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Hierarchical timer wheel for engine tasks, keyed on
+// FlutterEngineGetCurrentTime() nanoseconds.
+//
+// Time is cut into ticks of 2^kTickShift ns (~65us). Three levels of 256
+// slots cover ~16ms, ~4.3s and ~18min ahead of the wheel; a task is filed
+// under the level its distance falls into and cascades one level down when
+// the wheel reaches its slot. Insert and expiry are O(1), skipping over empty
+// slots is a bitmap scan. Tasks further out than the top level are refused
+// and left to the caller.
+//
+// A task never expires before its target time and at most one tick after it.
+// Tasks that expire on the same tick come out in the order they were added.
+// Not thread safe.
+class TimerWheel {
+ public:
+  static constexpr unsigned kTickShift = 16;
+  static constexpr unsigned kLevels = 3;
+  static constexpr unsigned kSlotBits = 8;
+  static constexpr unsigned kSlots = 1 << kSlotBits;
+
+  TimerWheel();
+
+  ~TimerWheel();
+
+  // Files |task| for |target_time|. Returns false if the target is beyond the
+  // range of the wheel.
+  bool Insert(FlutterTask task, uint64_t target_time);
+
+  // Moves the wheel to |now|, expiring every task that became due. The wheel
+  // range is relative to this point, so owners should advance it before
+  // filing a batch of tasks.
+  void Advance(uint64_t now);
+
+  // Pops the next task that is due at |now|. |target_time| may be null.
+  bool PopExpired(uint64_t now, FlutterTask* task, uint64_t* target_time);
+
+  // Target time of the task PopExpired() would return at |now|, without
+  // popping it. False if no task is due.
+  bool PeekExpired(uint64_t now, uint64_t* target_time);
+
+  // Earliest time at which a task may be due, or zero if the wheel is empty.
+  uint64_t NextDeadline() const;
+
+  // Number of tasks found due by the last Advance() that are still queued.
+  size_t expired_count() const { return expired_.count; }
+
+  size_t size() const { return size_; }
+
+ private:
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  struct Node {
+    FlutterTask task;
+    uint64_t target_time;
+    uint64_t expiry_tick;
+    uint32_t next;
+  };
+
+  struct List {
+    uint32_t head = kNil;
+    uint32_t tail = kNil;
+    uint32_t count = 0;
+    // Earliest expiry tick in the list, so the wheel can report an exact
+    // deadline without walking the slot.
+    uint64_t min_tick = UINT64_MAX;
+  };
+
+  std::vector<Node> nodes_;
+  uint32_t free_nodes_ = kNil;
+  List slots_[kLevels][kSlots];
+  uint64_t occupied_[kLevels][kSlots / 64] = {};
+  // Tasks whose tick has been reached, in expiry order.
+  List expired_;
+  size_t size_ = 0;
+  // All ticks before this one have been processed.
+  uint64_t next_tick_ = 0;
+  // Time of the last Advance(). Tasks targeted at or before it are due right
+  // away instead of waiting for the end of the current tick.
+  uint64_t now_ = 0;
+
+  uint32_t AllocateNode(FlutterTask task,
+                        uint64_t target_time,
+                        uint64_t expiry_tick);
+
+  void Append(List* list, uint32_t node);
+
+  void File(uint32_t node);
+
+  void Cascade(unsigned level, unsigned slot);
+
+  void ProcessTick(uint64_t tick);
+
+  // First tick at or after |next_tick_| on which anything is filed or has to
+  // cascade, or UINT64_MAX if the wheel holds no pending tasks.
+  uint64_t NextEventTick() const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_TIMER_WHEEL_H_
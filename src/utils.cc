@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <cstring>
 #include <sstream>
 
 namespace flutter {
@@ -94,4 +95,17 @@ bool IsFile(const std::string& path) {
   return S_ISREG(buf.st_mode);
 }
 
+bool HasExtension(const char* extensions, const char* name) {
+  const size_t length = strlen(name);
+  for (const char* found = strstr(extensions, name); found != nullptr;
+       found = strstr(found + length, name)) {
+    const bool starts = found == extensions || found[-1] == ' ';
+    const bool ends = found[length] == ' ' || found[length] == '\0';
+    if (starts && ends) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace flutter
@@ -26,6 +26,9 @@ std::string JoinPaths(std::initializer_list<std::string> components);
 
 bool IsFile(const std::string& path);
 
+// Whether the space separated |extensions| list has |name|.
+bool HasExtension(const char* extensions, const char* name);
+
 }  // namespace flutter
 
 #endif  // EMBEDDER_FLUTTER_UTILS_H_
\ No newline at end of file
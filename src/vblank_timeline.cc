@@ -0,0 +1,77 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vblank_timeline.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+constexpr uint64_t VblankTimeline::kDefaultInterval;
+
+void VblankTimeline::SetRefreshRate(int32_t refresh_mhz) {
+  if (refresh_mhz > 0) {
+    interval_ = 1000000000000ull / refresh_mhz;
+  }
+}
+
+void VblankTimeline::OnFrameDone(uint64_t time) {
+  last_frame_done_ = time;
+}
+
+uint64_t VblankTimeline::OnPresented(uint64_t submitted,
+                                     uint64_t presented,
+                                     uint64_t refresh,
+                                     uint64_t seq,
+                                     bool seq_counts_vblanks) {
+  if (refresh != 0) {
+    interval_ = refresh;
+  }
+
+  uint64_t missed = 0;
+  if (last_vblank_ != 0 && presented > last_vblank_) {
+    // The earliest vblank this frame could have made: after it was
+    // submitted, and after the previous frame.
+    uint64_t earliest = NextVblank(submitted);
+    earliest = std::max(earliest, last_vblank_ + interval_);
+    if (presented > earliest) {
+      const bool have_seq =
+          seq != 0 && last_vblank_seq_ != 0 && seq_counts_vblanks;
+      if (have_seq) {
+        const uint64_t earliest_seq =
+            last_vblank_seq_ +
+            (earliest - last_vblank_ + interval_ / 2) / interval_;
+        if (seq > earliest_seq) {
+          missed = seq - earliest_seq;
+        }
+      } else {
+        missed = (presented - earliest + interval_ / 2) / interval_;
+      }
+    }
+  }
+
+  last_vblank_ = presented;
+  last_vblank_seq_ = seq;
+  return missed;
+}
+
+uint64_t VblankTimeline::NextVblank(uint64_t time) const {
+  // A frame callback is sent some time after the vblank it belongs to, so
+  // presentation feedback is the better anchor.
+  const uint64_t base = last_vblank_ != 0 ? last_vblank_ : last_frame_done_;
+  if (base == 0) {
+    return time + interval_;
+  }
+  if (time < base) {
+    return base;
+  }
+  return base + ((time - base) / interval_ + 1) * interval_;
+}
+
+}  // namespace flutter
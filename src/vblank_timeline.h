@@ -0,0 +1,64 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_VBLANK_TIMELINE_H_
+#define EMBEDDER_FLUTTER_VBLANK_TIMELINE_H_
+
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Where the display's vblanks fall, in engine clock nanoseconds. Anchored
+// on the last presentation feedback, or failing that the last frame
+// callback, and spaced by the refresh interval the feedback or the output
+// mode reports. Not thread safe.
+class VblankTimeline {
+ public:
+  static constexpr uint64_t kDefaultInterval = 1000000000ull / 60;
+
+  VblankTimeline() = default;
+
+  uint64_t interval() const { return interval_; }
+
+  // The output's mode. Presentation feedback reports the exact interval
+  // with every frame and overrides this.
+  void SetRefreshRate(int32_t refresh_mhz);
+
+  // A frame callback arrived at |time|, some time after its vblank.
+  void OnFrameDone(uint64_t time);
+
+  // A frame submitted at |submitted| was shown at |presented|. |refresh| is
+  // the interval and |seq| the vblank counter the compositor reported, zero
+  // if unknown; |seq_counts_vblanks| if the counter steps once per vblank.
+  // Returns how many vblanks went by between the first one the frame could
+  // have made and the one it was shown on.
+  uint64_t OnPresented(uint64_t submitted,
+                       uint64_t presented,
+                       uint64_t refresh,
+                       uint64_t seq,
+                       bool seq_counts_vblanks);
+
+  // First vblank after |time|.
+  uint64_t NextVblank(uint64_t time) const;
+
+ private:
+  uint64_t interval_ = kDefaultInterval;
+  uint64_t last_frame_done_ = 0;
+  // Time and sequence number of the last presented frame.
+  uint64_t last_vblank_ = 0;
+  uint64_t last_vblank_seq_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(VblankTimeline);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_VBLANK_TIMELINE_H_
@@ -0,0 +1,122 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "watchdog.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "log.h"
+
+namespace flutter {
+
+// Sent to the watched thread to make it print its stack.
+static const int kBacktraceSignal = SIGUSR2;
+
+static const int kMaxFrames = 64;
+
+static void BacktraceSignalHandler(int signal) {
+  static const char kHeader[] = "Platform thread backtrace:\n";
+  void* frames[kMaxFrames];
+  int saved_errno = errno;
+  write(STDERR_FILENO, kHeader, sizeof(kHeader) - 1);
+  int count = backtrace(frames, kMaxFrames);
+  backtrace_symbols_fd(frames, count, STDERR_FILENO);
+  errno = saved_errno;
+}
+
+Watchdog::Watchdog(uint64_t threshold_ms)
+    : threshold_ns_(threshold_ms * 1000000ull),
+      watched_thread_(pthread_self()),
+      busy_since_(0),
+      activity_("idle") {}
+
+Watchdog::~Watchdog() {
+  Stop();
+}
+
+bool Watchdog::Start() {
+  if (threshold_ns_ == 0 || thread_.joinable()) {
+    return false;
+  }
+
+  // backtrace() loads the unwinder on first use, which is not safe inside a
+  // signal handler. Get that out of the way now.
+  void* frames[1];
+  backtrace(frames, 1);
+
+  struct sigaction action = {};
+  action.sa_handler = BacktraceSignalHandler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(kBacktraceSignal, &action, nullptr) != 0) {
+    LOG_ERROR(stderr, "Could not install the watchdog signal handler: %s\n",
+              strerror(errno));
+    return false;
+  }
+
+  watched_thread_ = pthread_self();
+  Busy("starting");
+  stopping_ = false;
+  thread_ = std::thread(&Watchdog::Run, this);
+  pthread_setname_np(thread_.native_handle(), "flutter.watchdog");
+  LOG_INFO("Started platform thread watchdog, threshold %llu ms\n",
+           (unsigned long long)(threshold_ns_ / 1000000));
+  return true;
+}
+
+void Watchdog::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+}
+
+void Watchdog::Run() {
+  const auto period = std::chrono::nanoseconds(threshold_ns_ / 4);
+  uint64_t reported_busy_since = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_condition_.wait_for(lock, period, [this] { return stopping_; })) {
+    const uint64_t busy_since = busy_since_.load(std::memory_order_relaxed);
+    const uint64_t now = FlutterEngineGetCurrentTime();
+
+    if (reported_busy_since != 0 && busy_since != reported_busy_since) {
+      LOG_ERROR(stderr, "Platform thread recovered after %llu ms\n",
+                (unsigned long long)((now - reported_busy_since) / 1000000));
+      reported_busy_since = 0;
+    }
+
+    if (busy_since == 0 || busy_since == reported_busy_since ||
+        now < busy_since || now - busy_since < threshold_ns_) {
+      continue;
+    }
+
+    // Once per stall: the stack will not have changed much afterwards.
+    reported_busy_since = busy_since;
+    stalls_++;
+    const char* activity = activity_.load(std::memory_order_relaxed);
+    LOG_ERROR(stderr, "Platform thread stalled for %llu ms in %s\n",
+              (unsigned long long)((now - busy_since) / 1000000),
+              activity ? activity : "unknown");
+    pthread_kill(watched_thread_, kBacktraceSignal);
+  }
+}
+
+}  // namespace flutter
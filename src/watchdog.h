@@ -0,0 +1,83 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_WATCHDOG_H_
+#define EMBEDDER_FLUTTER_WATCHDOG_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <flutter_embedder.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Notices when the watched thread stays busy for longer than a threshold,
+// logs what it is doing and has it print its own backtrace from a signal
+// handler.
+//
+// The watched thread only does relaxed atomic stores: Busy() when it wakes
+// up, SetActivity() when it starts something worth naming and Idle() before
+// it blocks again. The watchdog thread samples these a few times per
+// threshold, so a healthy loop never synchronizes with it.
+class Watchdog {
+ public:
+  explicit Watchdog(uint64_t threshold_ms);
+
+  // Stops the watchdog thread.
+  ~Watchdog();
+
+  // Starts watching the calling thread.
+  bool Start();
+
+  void Stop();
+
+  // Watched thread only.
+  void Busy(const char* activity) {
+    activity_.store(activity, std::memory_order_relaxed);
+    busy_since_.store(FlutterEngineGetCurrentTime(), std::memory_order_relaxed);
+  }
+
+  // Watched thread only. |activity| has to stay valid for the lifetime of
+  // the watchdog, it may be printed at any point.
+  void SetActivity(const char* activity) {
+    activity_.store(activity, std::memory_order_relaxed);
+  }
+
+  // Watched thread only.
+  void Idle() { busy_since_.store(0, std::memory_order_relaxed); }
+
+  uint64_t stalls() const { return stalls_; }
+
+ private:
+  const uint64_t threshold_ns_;
+  pthread_t watched_thread_;
+  std::atomic<uint64_t> busy_since_;
+  std::atomic<const char*> activity_;
+  uint64_t stalls_ = 0;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stopping_ = false;
+
+  void Run();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Watchdog);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_WATCHDOG_H_
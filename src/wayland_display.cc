@@ -13,54 +13,47 @@
 
 #include "wayland_display.h"
 
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 
+#include <flutter/standard_method_codec.h>
+
+#include <algorithm>
 #include <cstring>
 
 #include "log.h"
+#include "utils.h"
 
 namespace flutter {
 
-static int output_width, output_height;
-void WaylandDisplay::display_handle_geometry (void *data,
-			struct wl_output *wl_output,
-			int x,
-			int y,
-			int physical_width,
-			int physical_height,
-			int subpixel,
-			const char *make,
-			const char *model,
-      int transform){
-  LOG_INFO("  output listener display_handle_geometry corner:(%d,%d) size:(%d %d) make:%s model:%s transform:%d\n",
-    x, y, physical_width, physical_height, make, model, transform);
-}
-
-void WaylandDisplay::display_handle_mode (void *data,
-		    struct wl_output *wl_output,
-		    uint32_t flags,
-		    int width,
-		    int height,
-		    int refresh) {
-	output_width = width;
-	output_height = height;
-  LOG_INFO("  output listener display_handle_mode flags:0x%x size:(%d,%d)\n", flags, width, height);
-}
-
-const struct wl_output_listener WaylandDisplay::output_listener = {
-	.geometry = display_handle_geometry,
-	.mode = display_handle_mode,
-  .done = [](void *data,
-		     struct wl_output *wl_output) -> void {
-    LOG_INFO("  output done callback\n");
-  },
-  .scale = [](void *data,
-		      struct wl_output *wl_output,
-		      int32_t factor) -> void {
-    LOG_INFO ("  output scale callback factor:%d\n", factor);
-  },
-};
+// An empty rect is the identity.
+static FlutterRect UnionRect(const FlutterRect& a, const FlutterRect& b) {
+  if (a.right <= a.left || a.bottom <= a.top) {
+    return b;
+  }
+  if (b.right <= b.left || b.bottom <= b.top) {
+    return a;
+  }
+  return {std::min(a.left, b.left), std::min(a.top, b.top),
+          std::max(a.right, b.right), std::max(a.bottom, b.bottom)};
+}
+
+static FlutterRect IntersectRect(const FlutterRect& a, const FlutterRect& b) {
+  FlutterRect rect = {std::max(a.left, b.left), std::max(a.top, b.top),
+                      std::min(a.right, b.right), std::min(a.bottom, b.bottom)};
+  if (rect.right <= rect.left || rect.bottom <= rect.top) {
+    return {0, 0, 0, 0};
+  }
+  return rect;
+}
 
 #define DISPLAY reinterpret_cast<WaylandDisplay*>(data)
 
@@ -85,15 +78,17 @@ const wl_surface_listener WaylandDisplay::kSurfaceListener = {
 		      struct wl_surface *wl_surface,
 		      struct wl_output *output){
 
-      LOG_INFO("kSurfaceListener enter:\n");
-      if (output != DISPLAY->output_){
-        LOG_INFO("  Error: a different output object\n");
-      }
+      // A second output is normal, the surface can span several.
+      LOG_INFO("kSurfaceListener enter: wl_output@%u\n",
+               wl_proxy_get_id(reinterpret_cast<wl_proxy*>(output)));
+      DISPLAY->OnSurfaceEnterOutput(output);
   },
   .leave = [](void *data,
 		      struct wl_surface *wl_surface,
 		      struct wl_output *output){
-      LOG_INFO("kSurfaceListener leave:\n");
+      LOG_INFO("kSurfaceListener leave: wl_output@%u\n",
+               wl_proxy_get_id(reinterpret_cast<wl_proxy*>(output)));
+      DISPLAY->OnSurfaceLeaveOutput(output);
   },
 };
 
@@ -133,8 +128,81 @@ const wl_display_listener WaylandDisplay::kDisplayListener = {
     }
 };
 
-WaylandDisplay::WaylandDisplay(size_t width, size_t height)
-    : screen_width_(width), screen_height_(height) {
+const wl_callback_listener WaylandDisplay::kFrameListener = {
+    .done = [](void* data, struct wl_callback* callback, uint32_t time) -> void {
+      PendingFrame* pending = reinterpret_cast<PendingFrame*>(data);
+      pending->display->OnFrameDone(callback, pending);
+      PendingFrame::Release(pending);
+    },
+};
+
+const wp_presentation_listener WaylandDisplay::kPresentationListener = {
+    .clock_id = [](void* data,
+                   struct wp_presentation* presentation,
+                   uint32_t clock_id) -> void {
+      LOG_INFO("  wp_presentation clock id:%u\n", clock_id);
+      DISPLAY->presentation_clock_ = static_cast<clockid_t>(clock_id);
+    },
+};
+
+#define PENDING_PRESENTATION reinterpret_cast<PendingPresentation*>(data)
+
+const wp_presentation_feedback_listener
+    WaylandDisplay::kPresentationFeedbackListener = {
+        .sync_output = [](void* data,
+                          struct wp_presentation_feedback* feedback,
+                          struct wl_output* output) -> void {},
+
+        .presented = [](void* data,
+                        struct wp_presentation_feedback* feedback,
+                        uint32_t tv_sec_hi,
+                        uint32_t tv_sec_lo,
+                        uint32_t tv_nsec,
+                        uint32_t refresh,
+                        uint32_t seq_hi,
+                        uint32_t seq_lo,
+                        uint32_t flags) -> void {
+          PendingPresentation* pending = PENDING_PRESENTATION;
+          WaylandDisplay* display = pending->display;
+          const uint64_t presented = display->PresentationTimeToEngineTime(
+              (uint64_t(tv_sec_hi) << 32) | tv_sec_lo, tv_nsec);
+          display->OnPresented(*pending, presented, refresh,
+                               (uint64_t(seq_hi) << 32) | seq_lo, flags);
+          wp_presentation_feedback_destroy(feedback);
+          delete pending;
+        },
+
+        .discarded = [](void* data,
+                        struct wp_presentation_feedback* feedback) -> void {
+          PENDING_PRESENTATION->display->presentation_stats_.discarded++;
+          wp_presentation_feedback_destroy(feedback);
+          delete PENDING_PRESENTATION;
+        },
+};
+
+#undef PENDING_PRESENTATION
+
+WaylandDisplay::WaylandDisplay(size_t width,
+                               size_t height,
+                               const EmbedderOptions& options)
+    : options_(options),
+      screen_width_(width),
+      screen_height_(height),
+      input_reader_running_(false),
+      input_records_dropped_(0),
+      watchdog_(options.watchdog_ms),
+      frames_in_flight_(0),
+      frame_rate_(options.max_fps,
+                  options.idle_fps,
+                  options.idle_after_frames),
+      pending_window_size_(0),
+      last_vsync_start_(0),
+      last_vsync_target_(0),
+      oldest_frame_in_flight_(0) {
+  // The engine is started from this thread before Run() is entered, and it
+  // asks which thread is the platform thread while doing so.
+  platform_task_runner_.BindToCurrentThread();
+  platform_thread_.BindToCurrentThread();
   
   // clean member data structures before we do anything real
   for (int i=0; i < sizeof(touch_event.points)/sizeof(touch_point); i++){
@@ -146,6 +214,27 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height)
     FLWAY_ERR << "Invalid screen dimensions." << std::endl;
     return;
   }
+
+  render_scale_ = std::min(std::max(options_.render_scale, 0.25), 1.0);
+
+  if (!loop_.IsValid() || !platform_task_runner_.IsValid()) {
+    FLWAY_ERR << "Could not create the platform event loop." << std::endl;
+    return;
+  }
+
+  // Block the statistics signal before the engine and the input reader
+  // spawn their threads, so they inherit the mask and the signal is only
+  // ever seen through the signalfd.
+  sigset_t stats_signal;
+  sigemptyset(&stats_signal);
+  sigaddset(&stats_signal, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &stats_signal, nullptr);
+  stats_signal_fd_ = signalfd(-1, &stats_signal, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (stats_signal_fd_ < 0) {
+    FLWAY_ERR << "Could not create the statistics signalfd: "
+              << strerror(errno) << std::endl;
+  }
+
   FLWAY_LOG << " Screen dimensions: " + screen_width_ <<  ","  << screen_height_  << std::endl;
 
   display_ = wl_display_connect(nullptr);
@@ -157,10 +246,23 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height)
   FLWAY_LOG << "wl_display connected:" << std::endl;
 
   wl_display_add_listener(display_, &kDisplayListener, this);
+
+  if (options_.input_thread) {
+    // Has to exist before the seat is bound, see AnnounceRegistryInterface().
+    input_queue_ = wl_display_create_queue(display_);
+    if (!input_queue_) {
+      FLWAY_ERR << "Could not create the input event queue." << std::endl;
+      return;
+    }
+  }
 	// wl_display_add_global_listener(display, handle_global, &screenshooter);
 	// wl_display_iterate(display, WL_DISPLAY_READABLE);
 	// wl_display_roundtrip(display);
 
+  outputs_.reset(new OutputTracker(
+      [this](int32_t refresh_mhz) { vblanks_.SetRefreshRate(refresh_mhz); },
+      [this]() { NotifyDisplays(); }));
+
   registry_ = wl_display_get_registry(display_);
   if (!registry_) {
     FLWAY_ERR << "Could not get the wayland registry." << std::endl;
@@ -173,6 +275,10 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height)
 
   wl_display_roundtrip(display_);
 
+  // Globals bound above, wl_output in particular, describe themselves in
+  // reply to the bind.
+  wl_display_roundtrip(display_);
+
   if (!SetupEGL()) {
     FLWAY_ERR << "Could not setup EGL." << std::endl;
     return;
@@ -183,6 +289,17 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height)
 }
 
 WaylandDisplay::~WaylandDisplay() {
+  StopInputReader();
+  swap_thread_.reset();
+
+  // Releases the frames still waiting on the GPU.
+  gpu_fences_.reset();
+
+  if (stats_signal_fd_ >= 0) {
+    close(stats_signal_fd_);
+    stats_signal_fd_ = -1;
+  }
+
   // TODO: Not all member objects destroyed.
   if (shell_surface_) {
     wl_shell_surface_destroy(shell_surface_);
@@ -194,6 +311,9 @@ WaylandDisplay::~WaylandDisplay() {
     shell_ = nullptr;
   }
 
+  // Its subsurfaces are children of the main surface.
+  layer_compositor_.reset();
+
   if (egl_surface_) {
     eglDestroySurface(egl_display_, egl_surface_);
     egl_surface_ = nullptr;
@@ -209,21 +329,58 @@ WaylandDisplay::~WaylandDisplay() {
     window_ = nullptr;
   }
 
+  if (viewport_) {
+    wp_viewport_destroy(viewport_);
+    viewport_ = nullptr;
+  }
+
+  if (tearing_control_) {
+    wp_tearing_control_v1_destroy(tearing_control_);
+    tearing_control_ = nullptr;
+  }
+
   if (compositor_surface_) {
     wl_surface_destroy(compositor_surface_);
     compositor_surface_ = nullptr;
   }
 
+  if (subcompositor_) {
+    wl_subcompositor_destroy(subcompositor_);
+    subcompositor_ = nullptr;
+  }
+
   if (compositor_) {
     wl_compositor_destroy(compositor_);
     compositor_ = nullptr;
   }
 
+  if (presentation_) {
+    wp_presentation_destroy(presentation_);
+    presentation_ = nullptr;
+  }
+
+  if (viewporter_) {
+    wp_viewporter_destroy(viewporter_);
+    viewporter_ = nullptr;
+  }
+
+  if (tearing_control_manager_) {
+    wp_tearing_control_manager_v1_destroy(tearing_control_manager_);
+    tearing_control_manager_ = nullptr;
+  }
+
+  outputs_.reset();
+
   if (registry_) {
     wl_registry_destroy(registry_);
     registry_ = nullptr;
   }
 
+  if (input_queue_) {
+    wl_event_queue_destroy(input_queue_);
+    input_queue_ = nullptr;
+  }
+
   if (display_) {
     wl_display_flush(display_);
     wl_display_disconnect(display_);
@@ -241,16 +398,897 @@ bool WaylandDisplay::Run() {
     return false;
   }
 
+  platform_task_runner_.BindToCurrentThread();
+  platform_thread_.BindToCurrentThread();
+
+  const int wayland_fd = wl_display_get_fd(display_);
+  if (!loop_.AddFd(wayland_fd, EPOLLIN,
+                   [this](uint32_t events) {
+                     // Writability is picked up by the next flush.
+                     if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                       wayland_readable_ = true;
+                     }
+                   })) {
+    FLWAY_ERR << "Could not watch the wayland display." << std::endl;
+    return false;
+  }
+
+  const int task_fd = platform_task_runner_.wakeup_fd();
+  if (!loop_.AddFd(task_fd, EPOLLIN, [this](uint32_t events) {
+        platform_task_runner_.DrainPostedTasks();
+      })) {
+    FLWAY_ERR << "Could not watch the platform task runner." << std::endl;
+    loop_.RemoveFd(wayland_fd);
+    return false;
+  }
+
+  if (input_queue_ && !StartInputReader()) {
+    loop_.RemoveFd(task_fd);
+    loop_.RemoveFd(wayland_fd);
+    return false;
+  }
+
+  if (stats_signal_fd_ >= 0) {
+    loop_.AddFd(stats_signal_fd_, EPOLLIN, [this](uint32_t events) {
+      struct signalfd_siginfo info;
+      while (read(stats_signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+        DumpTaskStats();
+      }
+    });
+  }
+
+  const uint64_t stats_interval =
+      uint64_t(options_.stats_interval_s) * 1000000000ull;
+  if (stats_interval != 0) {
+    next_stats_time_ = FlutterEngineGetCurrentTime() + stats_interval;
+  }
+
+  if (options_.watchdog_ms != 0) {
+    watchdog_.Start();
+  }
+
+  NotifyDisplays();
+  SendLifecycleState("AppLifecycleState.resumed");
+
+  bool backlog = false;
   while (valid_) {
-    wl_display_dispatch(display_);
-    if (!TaskRunner.empty()) {
-      uint64_t current = FlutterEngineGetCurrentTime();
-      if (current >= TaskRunner.top().first) {
-        auto item = TaskRunner.top();
-        TaskRunner.pop();
-        FlutterApplication::FlutterRunTask(&item.second);
+    watchdog_.SetActivity("wayland dispatch");
+
+    // Anything already queued has to be dispatched before we may block on the
+    // socket, see wl_display_prepare_read(3).
+    while (wl_display_prepare_read(display_) != 0) {
+      wl_display_dispatch_pending(display_);
+    }
+    FlushWayland(wayland_fd);
+
+    // Sleep until the socket is readable, the earliest task is due or another
+    // thread posted work. With a backlog of due tasks we only look at the
+    // socket so input is not starved by a task burst, and vice versa.
+    uint64_t deadline = platform_task_runner_.NextDeadline();
+    if (next_stats_time_ != 0 &&
+        (deadline == 0 || next_stats_time_ < deadline)) {
+      deadline = next_stats_time_;
+    }
+    const uint64_t starvation_deadline = FrameCallbackStarvationDeadline();
+    if (starvation_deadline != 0 &&
+        (deadline == 0 || starvation_deadline < deadline)) {
+      deadline = starvation_deadline;
+    }
+    if (vsync_held_for_gpu_) {
+      // Fences can't wake the loop, look again shortly.
+      const uint64_t gpu_deadline =
+          FlutterEngineGetCurrentTime() + kGpuFencePollInterval;
+      if (deadline == 0 || gpu_deadline < deadline) {
+        deadline = gpu_deadline;
+      }
+    }
+    if (deferred_vsync_target_ != 0) {
+      const uint64_t vsync_deadline =
+          deferred_vsync_target_ - vblanks_.interval();
+      if (deadline == 0 || vsync_deadline < deadline) {
+        deadline = vsync_deadline;
+      }
+    }
+    loop_.SetDeadline(deadline);
+    wayland_readable_ = false;
+    watchdog_.Idle();
+    const int ready = loop_.Poll(backlog ? 0 : -1);
+    watchdog_.Busy("wayland dispatch");
+    if (ready < 0) {
+      wl_display_cancel_read(display_);
+      break;
+    }
+
+    if (!DispatchWaylandEvents()) {
+      break;
+    }
+
+    backlog = RunLanes();
+
+    const uint64_t now = FlutterEngineGetCurrentTime();
+    CheckFrameCallbackStarvation(now);
+    RunDeferredVsync(now);
+    if (gpu_fences_) {
+      gpu_fences_->Poll(now);
+    }
+    if (vsync_held_for_gpu_ && !GpuTooFarBehind()) {
+      vsync_held_for_gpu_ = false;
+      if (vsync_frame_.state == kFramePending && visible_) {
+        StartFrame(now);
+      }
+    }
+
+    if (next_stats_time_ != 0 &&
+        FlutterEngineGetCurrentTime() >= next_stats_time_) {
+      PrintTaskStatsSummary();
+      next_stats_time_ += stats_interval;
+    }
+  }
+
+  StopInputReader();
+  watchdog_.Stop();
+
+  LOG_INFO("Platform loop: %llu tasks run, task budget exhausted %llu times, "
+           "max overdue backlog %zu, %llu input preemptions, "
+           "%llu input events dropped, %llu stalls\n",
+           (unsigned long long)loop_stats_.tasks_run,
+           (unsigned long long)loop_stats_.budget_exhausted,
+           loop_stats_.max_overdue_backlog,
+           (unsigned long long)loop_stats_.input_preemptions,
+           (unsigned long long)input_records_dropped_.load(),
+           (unsigned long long)watchdog_.stalls());
+  LogLaneStats();
+  if (options_.vsync) {
+    LOG_INFO("  vsync: %llu requests, %llu answered by frame callbacks, "
+             "%llu right away, %llu held while hidden\n",
+             (unsigned long long)vsync_stats_.requests,
+             (unsigned long long)vsync_stats_.from_frame_callback,
+             (unsigned long long)vsync_stats_.immediate,
+             (unsigned long long)vsync_stats_.held_while_hidden);
+    LOG_INFO("  frame rate cap: %u fps (0 is native), %llu frame callbacks "
+             "skipped, idle at %u fps after %u frames without input\n",
+             frame_rate_.max_fps(), (unsigned long long)vsync_stats_.capped,
+             frame_rate_.idle_fps(), frame_rate_.idle_after_frames());
+    LOG_INFO("  %llu batons held while the GPU was more than %u frames "
+             "behind\n",
+             (unsigned long long)vsync_stats_.gpu_throttled,
+             options_.gpu_max_frames_behind);
+  }
+  if (options_.partial_repaint) {
+    const uint64_t frames = damage_stats_.frames;
+    LOG_INFO("  partial repaint: %llu of %llu frames, %llu.%llu%% of the "
+             "buffer damaged on average\n",
+             (unsigned long long)damage_stats_.partial_frames,
+             (unsigned long long)frames,
+             (unsigned long long)(frames ? damage_stats_.damaged_permille /
+                                               frames / 10
+                                         : 0),
+             (unsigned long long)(frames ? damage_stats_.damaged_permille /
+                                               frames % 10
+                                         : 0));
+  }
+  LOG_INFO("  hidden %llu times, %llu ms in total\n",
+           (unsigned long long)visibility_stats_.hidden,
+           (unsigned long long)(visibility_stats_.hidden_ns / 1000000));
+  LogPresentationStats();
+  frame_stats_.PrintSummary(stdout);
+  if (gpu_timer_ && gpu_timer_->disjoint_count() > 0) {
+    LOG_INFO("  %llu GPU timer results dropped, the GPU clock was "
+             "disjoint\n",
+             (unsigned long long)gpu_timer_->disjoint_count());
+  }
+  {
+    std::lock_guard<std::mutex> lock(present_stats_mutex_);
+    present_blocking_.PrintSummary(stdout, "  raster thread in present", 1000,
+                                   "us");
+  }
+  if (swap_thread_) {
+    swap_thread_->PrintSummary(stdout);
+  }
+  DumpTaskStats();
+
+  if (stats_signal_fd_ >= 0) {
+    loop_.RemoveFd(stats_signal_fd_);
+  }
+  loop_.RemoveFd(task_fd);
+  loop_.RemoveFd(wayland_fd);
+  return true;
+}
+
+// One iteration's worth of work, in priority order. Input and frame work is
+// cheap and latency critical, so it always runs to completion. Engine tasks
+// and plugin work share the task budget; whatever does not fit waits for the
+// next iteration, after the socket has been looked at again.
+bool WaylandDisplay::RunLanes() {
+  const uint64_t start = FlutterEngineGetCurrentTime();
+  const uint64_t budget = options_.task_budget_us * 1000;
+  const uint64_t deadline = budget != 0 ? start + budget : 0;
+
+  watchdog_.SetActivity("input delivery");
+  DeliverQueuedInput();
+
+  frame_work_.Run(0, &lane_stats_[static_cast<size_t>(WorkLane::kFrame)],
+                  &watchdog_);
+
+  bool backlog = RunExpiredTasks(start, deadline);
+
+  // Plugins run even when the engine used up the budget, one closure at
+  // least, so a task storm cannot starve them.
+  backlog |= plugin_work_.Run(
+      deadline, &lane_stats_[static_cast<size_t>(WorkLane::kPlugin)], &watchdog_);
+
+  return backlog;
+}
+
+// Runs the tasks that are due at |start|, oldest first, until |deadline| or
+// until the input reader queues an event. Tasks posted meanwhile wait for the
+// next iteration. Returns true if due tasks are left over.
+bool WaylandDisplay::RunExpiredTasks(uint64_t start, uint64_t deadline) {
+  LaneStats& stats = lane_stats_[static_cast<size_t>(WorkLane::kEngine)];
+
+  watchdog_.SetActivity("engine task");
+
+  const uint64_t depth = platform_task_runner_.size();
+  task_histograms_.depth.Record(depth);
+  interval_histograms_.depth.Record(depth);
+
+  uint64_t now = start;
+  FlutterTask task;
+  uint64_t target_time;
+  while (platform_task_runner_.PopExpiredTask(start, &task, &target_time)) {
+    const uint64_t lateness = now - target_time;
+    stats.Record(lateness);
+    task_histograms_.lateness.Record(lateness);
+    interval_histograms_.lateness.Record(lateness);
+
+    FlutterApplication::FlutterRunTask(&task);
+    loop_stats_.tasks_run++;
+
+    const uint64_t end = FlutterEngineGetCurrentTime();
+    task_histograms_.duration.Record(end - now);
+    interval_histograms_.duration.Record(end - now);
+    now = end;
+
+    if (!input_records_.empty()) {
+      loop_stats_.input_preemptions++;
+      return true;
+    }
+
+    if (deadline != 0 && now >= deadline) {
+      size_t backlog = platform_task_runner_.CountExpiredTasks(start);
+      if (backlog == 0) {
+        break;
+      }
+      loop_stats_.budget_exhausted++;
+      loop_stats_.overdue_backlog = backlog;
+      loop_stats_.max_overdue_backlog =
+          std::max(loop_stats_.max_overdue_backlog, backlog);
+      stats.RecordDepth(backlog);
+      return true;
+    }
+  }
+
+  loop_stats_.overdue_backlog = 0;
+  return false;
+}
+
+void WaylandDisplay::LogLaneStats() const {
+  for (size_t i = 0; i < kWorkLaneCount; i++) {
+    const LaneStats& stats = lane_stats_[i];
+    LOG_INFO("  %s lane: %llu runs, wait avg %llu us max %llu us, "
+             "max depth %zu\n",
+             WorkLaneName(static_cast<WorkLane>(i)),
+             (unsigned long long)stats.runs,
+             (unsigned long long)stats.average_wait_ns() / 1000,
+             (unsigned long long)stats.max_wait_ns / 1000, stats.max_depth);
+  }
+}
+
+void WaylandDisplay::PrintTaskStatsSummary() {
+  LOG_INFO("Platform tasks over the last %us, %zu queued:\n",
+           options_.stats_interval_s, platform_task_runner_.size());
+  interval_histograms_.lateness.PrintSummary(stdout, "  lateness", 1000, "us");
+  interval_histograms_.duration.PrintSummary(stdout, "  duration", 1000, "us");
+  interval_histograms_.depth.PrintSummary(stdout, "  depth", 1, "");
+  frame_stats_.PrintSummary(stdout);
+  fflush(stdout);
+  interval_histograms_.Reset();
+}
+
+void WaylandDisplay::DumpTaskStats() const {
+  LOG_INFO("Platform task statistics since start:\n");
+  task_histograms_.lateness.PrintBuckets(stdout, "lateness", 1000, "us");
+  task_histograms_.duration.PrintBuckets(stdout, "duration", 1000, "us");
+  task_histograms_.depth.PrintBuckets(stdout, "depth", 1, "");
+  LogPresentationStats();
+  frame_stats_.PrintSummary(stdout);
+  fflush(stdout);
+}
+
+void WaylandDisplay::RequestVsync(intptr_t baton) {
+  vsync_stats_.requests++;
+  vsync_frame_.state = kFramePending;
+  vsync_frame_.baton = baton;
+
+  if (!visible_) {
+    // Held until the surface shows again, see UpdateVisibility().
+    vsync_stats_.held_while_hidden++;
+    return;
+  }
+
+  if (frames_in_flight_ > 0) {
+    // The frame callback of the frame on its way to the screen answers it.
+    return;
+  }
+
+  // Nothing in flight, so no callback is coming. Start right away and aim
+  // for the next vblank, which keeps animations in phase with the display
+  // after an idle period.
+  vsync_stats_.immediate++;
+  StartFrame(FlutterEngineGetCurrentTime());
+}
+
+void WaylandDisplay::OnFrameDone(wl_callback* callback,
+                                 PendingFrame* pending) {
+  FLWAY_CHECK_THREAD(platform_thread_, "WaylandDisplay::OnFrameDone");
+  wl_callback_destroy(callback);
+  frames_in_flight_--;
+
+  // The callback's own timestamp has an unspecified base, the engine wants
+  // its monotonic clock.
+  const uint64_t frame_done = FlutterEngineGetCurrentTime();
+  vblanks_.OnFrameDone(frame_done);
+  if (gpu_fences_) {
+    gpu_fences_->Poll(frame_done);
+  }
+  // Frames still in flight have been waiting since now at most.
+  oldest_frame_in_flight_ = frame_done;
+
+  if (frame_callbacks_starved_) {
+    // The compositor shows us again. Not a jank, don't count the frame.
+    // Fires a held baton if that makes the surface visible.
+    frame_callbacks_starved_ = false;
+    UpdateVisibility();
+  } else {
+    if (gpu_timer_) {
+      gpu_timer_->TakeResults(&gpu_render_times_);
+      for (uint64_t gpu_time : gpu_render_times_) {
+        frame_stats_.RecordGpuRenderTime(gpu_time);
       }
     }
+
+    FrameTiming timing = pending->timing;
+    timing.swap_done = pending->swap_done.load(std::memory_order_acquire);
+    timing.gpu_done = pending->gpu_done;
+    timing.frame_done = frame_done;
+    const uint64_t target = timing.vsync_target != 0
+                                ? timing.vsync_target
+                                : vblanks_.NextVblank(timing.present);
+    frame_stats_.Record(timing, target, vblanks_.interval());
+
+    if (render_scale_controller_) {
+      // Raster time is what the scale buys back. Without it, the whole
+      // frame from the baton on.
+      const uint64_t start = timing.raster_start != 0 ? timing.raster_start
+                                                      : timing.vsync_start;
+      if (start != 0 && timing.present > start &&
+          render_scale_controller_->Record(
+              timing.present - start,
+              frame_rate_.FrameInterval(vblanks_.interval()))) {
+        SetRenderScale(render_scale_controller_->scale());
+      }
+    }
+
+    if (frame_rate_.OnFrame()) {
+      LOG_INFO("No input for %u frames, capping at %u fps\n",
+               frame_rate_.idle_after_frames(), frame_rate_.frame_rate());
+    }
+  }
+
+  if (!visible_) {
+    return;
+  }
+
+  if (vsync_frame_.state == kFramePending) {
+    vsync_stats_.from_frame_callback++;
+    StartFrame(frame_done);
+  } else {
+    vsync_frame_.state = kFrameRendered;
+  }
+}
+
+void WaylandDisplay::StartFrame(uint64_t now) {
+  if (HoldForGpu()) {
+    return;
+  }
+
+  const uint64_t target = vblanks_.NextVblank(now);
+  const uint64_t vsync_interval = vblanks_.interval();
+  const uint64_t frame_interval = frame_rate_.FrameInterval(vsync_interval);
+  const uint64_t last_target = last_vsync_target_;
+  if (frame_interval > vsync_interval && last_target != 0) {
+    // Skip the vblanks in between. Half an interval of slack absorbs the
+    // jitter of the vblank estimate.
+    const uint64_t earliest = last_target + frame_interval;
+    if (target + vsync_interval / 2 < earliest) {
+      vsync_stats_.capped++;
+      deferred_vsync_target_ = earliest;
+      return;
+    }
+  }
+  deferred_vsync_target_ = 0;
+  FireVsync(now, target);
+}
+
+void WaylandDisplay::RunDeferredVsync(uint64_t now) {
+  if (deferred_vsync_target_ == 0 ||
+      now + vblanks_.interval() < deferred_vsync_target_) {
+    return;
+  }
+  const uint64_t target = deferred_vsync_target_;
+  deferred_vsync_target_ = 0;
+  if (vsync_frame_.state != kFramePending || !visible_) {
+    // Hiding holds the baton, UpdateVisibility() starts the frame.
+    return;
+  }
+  if (HoldForGpu()) {
+    return;
+  }
+  FireVsync(now, std::max(target, vblanks_.NextVblank(now)));
+}
+
+void WaylandDisplay::OnUserInput() {
+  if (pending_input_ == 0) {
+    pending_input_ = FlutterEngineGetCurrentTime();
+  }
+  if (!frame_rate_.OnInput()) {
+    return;
+  }
+  LOG_INFO("Input, back to %u fps (0 is native)\n", frame_rate_.frame_rate());
+  if (deferred_vsync_target_ != 0 && vsync_frame_.state == kFramePending) {
+    StartFrame(FlutterEngineGetCurrentTime());
+  }
+}
+
+void WaylandDisplay::FireVsync(uint64_t frame_start, uint64_t frame_target) {
+  vsync_frame_.state = kFrameRendering;
+  frame_start_events_ |= kFrameStartVsync;
+  last_vsync_start_ = frame_start;
+  last_vsync_target_ = frame_target;
+  last_vsync_input_ = pending_input_;
+  pending_input_ = 0;
+  FlutterEngineResult result =
+      FlutterEngineOnVsync(FlutterApplication::GetFlutterEngine(),
+                           vsync_frame_.baton, frame_start, frame_target);
+  if (result != kSuccess) {
+    LOG_ERROR(stderr, "FlutterEngineOnVsync failed: %s\n",
+              FLUTTER_RESULT_TO_STRING(result));
+  }
+  vsync_frame_.baton = 0;
+}
+
+void WaylandDisplay::OnPresented(const PendingPresentation& pending,
+                                 uint64_t presented,
+                                 uint32_t refresh,
+                                 uint64_t seq,
+                                 uint32_t flags) {
+  FLWAY_CHECK_THREAD(platform_thread_, "WaylandDisplay::OnPresented");
+  PresentationStats& stats = presentation_stats_;
+  stats.presented++;
+  stats.vsync += (flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC) != 0;
+  stats.hw_clock += (flags & WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK) != 0;
+  stats.hw_completion +=
+      (flags & WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION) != 0;
+  stats.zero_copy += (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) != 0;
+
+  if (presented > pending.submitted) {
+    present_latency_.Record(presented - pending.submitted);
+  }
+
+  stats.missed_vblanks += vblanks_.OnPresented(
+      pending.submitted, presented, refresh, seq,
+      (flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC) != 0);
+}
+
+uint64_t WaylandDisplay::PresentationTimeToEngineTime(uint64_t sec,
+                                                      uint32_t nsec) const {
+  const uint64_t time = sec * 1000000000ull + nsec;
+  if (presentation_clock_ == CLOCK_MONOTONIC) {
+    return time;
+  }
+
+  // Usually CLOCK_MONOTONIC_RAW or a hardware clock; rebase it on ours.
+  struct timespec clock_now;
+  clock_gettime(presentation_clock_, &clock_now);
+  const uint64_t engine_now = FlutterEngineGetCurrentTime();
+  const uint64_t clock_now_ns =
+      uint64_t(clock_now.tv_sec) * 1000000000ull + clock_now.tv_nsec;
+  return time + engine_now - clock_now_ns;
+}
+
+void WaylandDisplay::LogPresentationStats() const {
+  if (!presentation_) {
+    return;
+  }
+  const PresentationStats& stats = presentation_stats_;
+  LOG_INFO("  presentation: %llu presented, %llu discarded, %llu missed "
+           "vblanks, refresh %llu us; vsync %llu, hw clock %llu, "
+           "hw completion %llu, zero copy %llu\n",
+           (unsigned long long)stats.presented,
+           (unsigned long long)stats.discarded,
+           (unsigned long long)stats.missed_vblanks,
+           (unsigned long long)vblanks_.interval() / 1000,
+           (unsigned long long)stats.vsync,
+           (unsigned long long)stats.hw_clock,
+           (unsigned long long)stats.hw_completion,
+           (unsigned long long)stats.zero_copy);
+  present_latency_.PrintSummary(stdout, "  present latency", 1000, "us");
+}
+
+// Hidden when the surface left every output it was on, or when the
+// compositor sat on a frame callback for longer than the hidden timeout,
+// which is how it treats covered surfaces.
+void WaylandDisplay::UpdateVisibility() {
+  if (surface_output_count_ > 0) {
+    surface_entered_once_ = true;
+  }
+  // Before the first enter the surface is not on any output yet, but it is
+  // not hidden either.
+  const bool on_output = surface_output_count_ > 0 || !surface_entered_once_;
+  const bool visible = on_output && !frame_callbacks_starved_;
+  if (visible == visible_) {
+    return;
+  }
+  visible_ = visible;
+
+  if (!visible_) {
+    LOG_INFO("Surface hidden (%s), pausing\n",
+             frame_callbacks_starved_ ? "no frame callbacks" : "left outputs");
+    visibility_stats_.hidden++;
+    hidden_since_ = FlutterEngineGetCurrentTime();
+    deferred_vsync_target_ = 0;
+    SendLifecycleState("AppLifecycleState.inactive");
+    SendLifecycleState("AppLifecycleState.paused");
+    return;
+  }
+
+  const uint64_t hidden_for = FlutterEngineGetCurrentTime() - hidden_since_;
+  visibility_stats_.hidden_ns += hidden_for;
+  LOG_INFO("Surface visible again after %llu ms, resuming\n",
+           (unsigned long long)(hidden_for / 1000000));
+  SendLifecycleState("AppLifecycleState.resumed");
+
+  if (vsync_frame_.state == kFramePending) {
+    StartFrame(FlutterEngineGetCurrentTime());
+  }
+}
+
+void WaylandDisplay::CheckFrameCallbackStarvation(uint64_t now) {
+  if (frame_callbacks_starved_ || options_.hidden_timeout_ms == 0 ||
+      frames_in_flight_ == 0) {
+    return;
+  }
+  const uint64_t timeout = uint64_t(options_.hidden_timeout_ms) * 1000000;
+  if (now - oldest_frame_in_flight_ < timeout) {
+    return;
+  }
+  frame_callbacks_starved_ = true;
+  UpdateVisibility();
+}
+
+uint64_t WaylandDisplay::FrameCallbackStarvationDeadline() const {
+  if (frame_callbacks_starved_ || options_.hidden_timeout_ms == 0 ||
+      frames_in_flight_ == 0) {
+    return 0;
+  }
+  return oldest_frame_in_flight_ +
+         uint64_t(options_.hidden_timeout_ms) * 1000000;
+}
+
+bool WaylandDisplay::SendWindowMetrics() {
+  return FlutterApplication::SendWindowMetrics(render_width_, render_height_,
+                                               render_scale_);
+}
+
+void WaylandDisplay::SetRenderScale(double scale) {
+  FLWAY_CHECK_THREAD(platform_thread_, "WaylandDisplay::SetRenderScale");
+  const size_t width = std::max<size_t>(1, lround(screen_width_ * scale));
+  const size_t height = std::max<size_t>(1, lround(screen_height_ * scale));
+  if (width == render_width_ && height == render_height_) {
+    return;
+  }
+  render_scale_ = scale;
+  render_width_ = width;
+  render_height_ = height;
+  pending_window_size_ = (uint64_t(width) << 32) | height;
+  LOG_INFO("Render scale %.2f, rendering at %zux%zu\n", scale, width, height);
+  if (!SendWindowMetrics()) {
+    FLWAY_ERR << "Could not send the window metrics." << std::endl;
+  }
+}
+
+void WaylandDisplay::ApplySurfaceRegions() {
+  wl_region* opaque = wl_compositor_create_region(compositor_);
+  for (const SurfaceRect& rect : opaque_region_) {
+    wl_region_add(opaque, rect.x, rect.y, rect.width, rect.height);
+  }
+  wl_surface_set_opaque_region(compositor_surface_, opaque);
+  wl_region_destroy(opaque);
+
+  wl_region* input = wl_compositor_create_region(compositor_);
+  for (const SurfaceRect& rect : input_region_) {
+    wl_region_add(input, rect.x, rect.y, rect.width, rect.height);
+  }
+  wl_surface_set_input_region(compositor_surface_, input);
+  wl_region_destroy(input);
+}
+
+// [[x, y, width, height], ...] in logical pixels, which are surface
+// coordinates.
+bool WaylandDisplay::ParseSurfaceRects(const EncodableValue& value,
+                                       std::vector<SurfaceRect>* rects) {
+  if (!value.IsList()) {
+    return false;
+  }
+  rects->clear();
+  for (const EncodableValue& entry : value.ListValue()) {
+    if (!entry.IsList() || entry.ListValue().size() != 4) {
+      return false;
+    }
+    int32_t numbers[4];
+    for (size_t i = 0; i < 4; i++) {
+      const EncodableValue& number = entry.ListValue()[i];
+      if (number.IsInt() || number.IsLong()) {
+        numbers[i] = static_cast<int32_t>(number.LongValue());
+      } else if (number.IsDouble()) {
+        numbers[i] = static_cast<int32_t>(lround(number.DoubleValue()));
+      } else {
+        return false;
+      }
+    }
+    if (numbers[2] > 0 && numbers[3] > 0) {
+      rects->push_back({numbers[0], numbers[1], numbers[2], numbers[3]});
+    }
+  }
+  return true;
+}
+
+void WaylandDisplay::RegisterPlatformMessageHandlers(
+    FlutterApplication* application) {
+  application->SetPlatformMessageHandler(
+      "flutter_embedder/display", [this](const FlutterPlatformMessage* message) {
+        OnDisplayChannelMessage(message);
+      });
+}
+
+// Standard method codec, so apps talk to it with a plain MethodChannel.
+//   setFrameRate {fps, idleFps?, idleAfterFrames?}, fps 0 is native
+//   getFrameRate -> {fps, idleFps, idleAfterFrames, idle, effectiveFps}
+//   setTearing {enabled}, async flips, fails without wp_tearing_control_v1
+//   setSurfaceRegions {opaque?, input?}, lists of [x, y, width, height];
+//       --translucent only, an absent input region means the whole surface
+void WaylandDisplay::OnDisplayChannelMessage(
+    const FlutterPlatformMessage* message) {
+  FLWAY_CHECK_THREAD(platform_thread_,
+                     "WaylandDisplay::OnDisplayChannelMessage");
+  auto codec = &flutter::StandardMethodCodec::GetInstance();
+  auto method_call =
+      codec->DecodeMethodCall(message->message, message->message_size);
+  std::unique_ptr<std::vector<uint8_t>> result;
+
+  const EncodableMap* arguments = nullptr;
+  if (method_call && method_call->arguments() &&
+      method_call->arguments()->IsMap()) {
+    arguments = &method_call->arguments()->MapValue();
+  }
+  auto int_argument = [arguments](const char* name, int64_t* value) {
+    if (arguments == nullptr) {
+      return false;
+    }
+    auto it = arguments->find(EncodableValue(name));
+    if (it == arguments->end() ||
+        !(it->second.IsInt() || it->second.IsLong()) ||
+        it->second.LongValue() < 0) {
+      return false;
+    }
+    *value = it->second.LongValue();
+    return true;
+  };
+
+  if (!method_call) {
+    FLWAY_ERR << "Could not decode a flutter_embedder/display message"
+              << std::endl;
+  } else if (method_call->method_name() == "setFrameRate") {
+    int64_t fps = 0;
+    if (!int_argument("fps", &fps)) {
+      result = codec->EncodeErrorEnvelope("argument_error",
+                                          "fps has to be a number >= 0");
+    } else {
+      frame_rate_.SetMaxFrameRate(static_cast<uint32_t>(fps));
+      int64_t idle_fps = frame_rate_.idle_fps();
+      int64_t idle_after_frames = frame_rate_.idle_after_frames();
+      if (int_argument("idleFps", &idle_fps) ||
+          int_argument("idleAfterFrames", &idle_after_frames)) {
+        frame_rate_.SetIdleFrameRate(static_cast<uint32_t>(idle_fps),
+                                     static_cast<uint32_t>(idle_after_frames));
+      }
+      LOG_INFO("Frame rate cap %u fps (0 is native), idle %u fps after %u "
+               "frames\n",
+               frame_rate_.max_fps(), frame_rate_.idle_fps(),
+               frame_rate_.idle_after_frames());
+      result = codec->EncodeSuccessEnvelope();
+    }
+  } else if (method_call->method_name() == "setTearing") {
+    const EncodableValue* enabled = nullptr;
+    if (arguments != nullptr) {
+      auto it = arguments->find(EncodableValue("enabled"));
+      if (it != arguments->end() && it->second.IsBool()) {
+        enabled = &it->second;
+      }
+    }
+    if (enabled == nullptr) {
+      result = codec->EncodeErrorEnvelope("argument_error",
+                                          "enabled has to be a bool");
+    } else if (!SetTearing(enabled->BoolValue())) {
+      result = codec->EncodeErrorEnvelope(
+          "unavailable", "Tearing needs wp_tearing_control_v1 and vsync");
+    } else {
+      result = codec->EncodeSuccessEnvelope();
+    }
+  } else if (method_call->method_name() == "setSurfaceRegions") {
+    std::vector<SurfaceRect> opaque;
+    std::vector<SurfaceRect> input = {
+        {0, 0, static_cast<int32_t>(screen_width_),
+         static_cast<int32_t>(screen_height_)}};
+    auto region_argument = [arguments](const char* name,
+                                       std::vector<SurfaceRect>* rects) {
+      auto it = arguments->find(EncodableValue(name));
+      return it == arguments->end() || it->second.IsNull() ||
+             ParseSurfaceRects(it->second, rects);
+    };
+    if (!options_.translucent) {
+      result = codec->EncodeErrorEnvelope(
+          "not_translucent", "The surface is opaque, start with --translucent");
+    } else if (arguments == nullptr || !region_argument("opaque", &opaque) ||
+               !region_argument("input", &input)) {
+      result = codec->EncodeErrorEnvelope(
+          "argument_error", "Regions are lists of [x, y, width, height]");
+    } else {
+      opaque_region_ = std::move(opaque);
+      input_region_ = std::move(input);
+      ApplySurfaceRegions();
+      result = codec->EncodeSuccessEnvelope();
+    }
+  } else if (method_call->method_name() == "getFrameRate") {
+    EncodableValue value(EncodableMap{
+        {EncodableValue("fps"),
+         EncodableValue(static_cast<int32_t>(frame_rate_.max_fps()))},
+        {EncodableValue("idleFps"),
+         EncodableValue(static_cast<int32_t>(frame_rate_.idle_fps()))},
+        {EncodableValue("idleAfterFrames"),
+         EncodableValue(static_cast<int32_t>(frame_rate_.idle_after_frames()))},
+        {EncodableValue("idle"), EncodableValue(frame_rate_.idle())},
+        {EncodableValue("effectiveFps"),
+         EncodableValue(static_cast<int32_t>(
+             1000000000ull / frame_rate_.FrameInterval(vblanks_.interval())))},
+    });
+    result = codec->EncodeSuccessEnvelope(&value);
+  }
+
+  // An empty response tells the app the method is not implemented.
+  FlutterEngineSendPlatformMessageResponse(
+      FlutterApplication::GetFlutterEngine(), message->response_handle,
+      result ? result->data() : nullptr, result ? result->size() : 0);
+}
+
+void WaylandDisplay::SendLifecycleState(const char* state) {
+  // flutter/lifecycle uses the string codec: the bare UTF-8 text.
+  FlutterEngineResult result = FlutterApplication::FlutterSendMessage(
+      "flutter/lifecycle", reinterpret_cast<const uint8_t*>(state),
+      strlen(state));
+  if (result != kSuccess) {
+    LOG_ERROR(stderr, "Could not send %s: %s\n", state,
+              FLUTTER_RESULT_TO_STRING(result));
+  }
+}
+
+bool WaylandDisplay::StartInputReader() {
+  input_reader_stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (input_reader_stop_fd_ < 0) {
+    FLWAY_ERR << "Could not create input reader eventfd: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  input_reader_running_ = true;
+  input_reader_ = std::thread(&WaylandDisplay::RunInputReader, this);
+  pthread_setname_np(input_reader_.native_handle(), "wayland.input");
+  LOG_INFO("Started wayland input reader thread\n");
+  return true;
+}
+
+void WaylandDisplay::StopInputReader() {
+  if (!input_reader_.joinable()) {
+    return;
+  }
+
+  input_reader_running_ = false;
+  uint64_t value = 1;
+  write(input_reader_stop_fd_, &value, sizeof(value));
+  input_reader_.join();
+
+  close(input_reader_stop_fd_);
+  input_reader_stop_fd_ = -1;
+}
+
+// Reads the socket on behalf of the input objects' private queue. The
+// platform thread reads the same socket for the default queue; libwayland
+// lets both prepare a read and have whichever comes last do it, see
+// wl_display_prepare_read_queue(3).
+void WaylandDisplay::RunInputReader() {
+  struct pollfd fds[2] = {};
+  fds[0].fd = wl_display_get_fd(display_);
+  fds[0].events = POLLIN;
+  fds[1].fd = input_reader_stop_fd_;
+  fds[1].events = POLLIN;
+
+  while (input_reader_running_) {
+    while (wl_display_prepare_read_queue(display_, input_queue_) != 0) {
+      wl_display_dispatch_queue_pending(display_, input_queue_);
+    }
+    wl_display_flush(display_);
+
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+      FLWAY_ERR << "Input reader poll failed: " << strerror(errno)
+                << std::endl;
+      wl_display_cancel_read(display_);
+      break;
+    }
+
+    if (!(fds[0].revents & POLLIN)) {
+      wl_display_cancel_read(display_);
+      continue;
+    }
+
+    if (wl_display_read_events(display_) != 0) {
+      FLWAY_ERR << "Input reader lost the wayland display." << std::endl;
+      break;
+    }
+    wl_display_dispatch_queue_pending(display_, input_queue_);
+  }
+}
+
+void WaylandDisplay::FlushWayland(int wayland_fd) {
+  // A full socket buffer takes the rest of the requests on the next
+  // iteration, once the fd is writable again.
+  const bool pending = wl_display_flush(display_) < 0 && errno == EAGAIN;
+  if (pending == wayland_flush_pending_) {
+    return;
+  }
+  if (loop_.ModifyFd(wayland_fd, pending ? EPOLLIN | EPOLLOUT : EPOLLIN)) {
+    wayland_flush_pending_ = pending;
+  }
+}
+
+bool WaylandDisplay::DispatchWaylandEvents() {
+  FLWAY_CHECK_THREAD(platform_thread_, "WaylandDisplay::DispatchWaylandEvents");
+
+  if (!wayland_readable_) {
+    wl_display_cancel_read(display_);
+    return true;
+  }
+
+  if (wl_display_read_events(display_) != 0) {
+    FLWAY_ERR << "Lost connection to the wayland display: "
+              << strerror(errno) << std::endl;
+    valid_ = false;
+    return false;
+  }
+
+  if (wl_display_dispatch_pending(display_) < 0) {
+    FLWAY_ERR << "Could not dispatch wayland events." << std::endl;
+    valid_ = false;
+    return false;
   }
 
   return true;
@@ -301,13 +1339,11 @@ static void LogLastEGLError() {
 }
 
 bool WaylandDisplay::SetupEGL() {
-  if (!compositor_ || !shell_ || !output_) {
+  if (!compositor_ || !shell_ || !outputs_->primary()) {
     FLWAY_ERR << "EGL setup needs: compositor / shell / output connection."
                 << std::endl;
     return false;
   }
-  wl_output_add_listener(output_, &output_listener, this);
-
   compositor_surface_ = wl_compositor_create_surface(compositor_);
 
   if (!compositor_surface_) {
@@ -330,11 +1366,13 @@ bool WaylandDisplay::SetupEGL() {
 
   wl_shell_surface_set_toplevel(shell_surface_);
 
-  window_ = wl_egl_window_create(compositor_surface_, screen_width_, screen_height_);
-
-  if (!window_) {
-    FLWAY_ERR << "Could not create EGL window." << std::endl;
-    return false;
+  if (tearing_control_manager_) {
+    tearing_control_ = wp_tearing_control_manager_v1_get_tearing_control(
+        tearing_control_manager_, compositor_surface_);
+  }
+  if (options_.tearing && !SetTearing(true)) {
+    FLWAY_ERR << "Tearing needs wp_tearing_control_v1 and vsync, presenting "
+                 "with vsync." << std::endl;
   }
 
   if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
@@ -356,6 +1394,30 @@ bool WaylandDisplay::SetupEGL() {
     return false;
   }
 
+  const char* egl_extensions = eglQueryString(egl_display_, EGL_EXTENSIONS);
+  if (options_.partial_repaint && egl_extensions) {
+    has_buffer_age_ = HasExtension(egl_extensions, "EGL_EXT_buffer_age");
+    if (HasExtension(egl_extensions, "EGL_KHR_swap_buffers_with_damage")) {
+      swap_buffers_with_damage_ =
+          reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+              eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    } else if (HasExtension(egl_extensions,
+                            "EGL_EXT_swap_buffers_with_damage")) {
+      swap_buffers_with_damage_ =
+          reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+              eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    }
+    LOG_INFO("Partial repaint: buffer age %s, swap with damage %s\n",
+             has_buffer_age_ ? "yes" : "no",
+             swap_buffers_with_damage_ ? "yes" : "no");
+  }
+  if (egl_sync_.Load(egl_extensions)) {
+    gpu_fences_.reset(new GpuFenceQueue(egl_display_, egl_sync_));
+  }
+  if (!egl_sync_.available()) {
+    LOG_INFO("No EGL_KHR_fence_sync, GPU completion is not tracked\n");
+  }
+
   EGLConfig egl_config = nullptr;
 
   // Choose an EGL config to use for the surface and context.
@@ -391,20 +1453,6 @@ bool WaylandDisplay::SetupEGL() {
     }
   }
 
-  // Create an EGL window surface with the matched config.
-  {
-    const EGLint attribs[] = {EGL_NONE};
-
-    egl_surface_ = eglCreateWindowSurface(egl_display_, egl_config, window_, attribs);
-
-    if (egl_surface_ == EGL_NO_SURFACE) {
-      LogLastEGLError();
-      FLWAY_ERR << "EGL surface was null during surface selection."
-                  << std::endl;
-      return false;
-    }
-  }
-
   EGLint egl_error;
 
   // Create an EGL context with the match config.
@@ -427,7 +1475,89 @@ bool WaylandDisplay::SetupEGL() {
       return false;
     }
 
+    if (options_.compositor && subcompositor_) {
+      egl_layer_context_ = eglCreateContext(egl_display_, egl_config,
+                                            egl_root_context_, attribs);
+      if (egl_layer_context_ == EGL_NO_CONTEXT) {
+        LogLastEGLError();
+        FLWAY_ERR << "Could not create the layer context." << std::endl;
+      } else {
+        layer_compositor_.reset(new LayerCompositor(
+            compositor_, subcompositor_, compositor_surface_, egl_display_,
+            egl_config, egl_layer_context_,
+            static_cast<size_t>(options_.backing_store_budget_mb) << 20));
+      }
+    } else if (options_.compositor) {
+      FLWAY_ERR << "No wl_subcompositor for --compositor." << std::endl;
+    }
+
+  }
+
+  // After the layer compositor, which rules out a render scale, and before
+  // the window, whose buffers are the render size.
+  bool dynamic_scale = options_.min_render_scale > 0;
+  if (layer_compositor_ && (render_scale_ < 1.0 || dynamic_scale)) {
+    // Layers are placed in surface coordinates.
+    FLWAY_ERR << "The render scale does not work with --compositor, "
+                 "rendering at full size." << std::endl;
+    render_scale_ = 1.0;
+    dynamic_scale = false;
+  }
+  if (!viewporter_ && (render_scale_ < 1.0 || dynamic_scale)) {
+    FLWAY_ERR << "No wp_viewporter, rendering at full size." << std::endl;
+    render_scale_ = 1.0;
+  } else if (viewporter_) {
+    // The destination pins the surface size, whatever the buffer size.
+    viewport_ = wp_viewporter_get_viewport(viewporter_, compositor_surface_);
+    wp_viewport_set_destination(viewport_, screen_width_, screen_height_);
+    if (dynamic_scale) {
+      render_scale_controller_.reset(new RenderScaleController(
+          std::min(std::max(options_.min_render_scale, 0.25), render_scale_),
+          render_scale_));
+    }
+  }
+  render_width_ = std::max<size_t>(1, lround(screen_width_ * render_scale_));
+  render_height_ = std::max<size_t>(1, lround(screen_height_ * render_scale_));
+  if (render_scale_ < 1.0 || render_scale_controller_) {
+    LOG_INFO("Rendering at %zux%zu (scale %.2f%s), shown at %zux%zu\n",
+             render_width_, render_height_, render_scale_,
+             render_scale_controller_ ? ", dynamic" : "", screen_width_,
+             screen_height_);
+  }
+
+  window_ = wl_egl_window_create(compositor_surface_, render_width_,
+                                 render_height_);
+  window_width_ = render_width_;
+  window_height_ = render_height_;
+
+  if (!window_) {
+    FLWAY_ERR << "Could not create EGL window." << std::endl;
+    return false;
+  }
+
+  // Create an EGL window surface with the matched config.
+  {
+    const EGLint attribs[] = {EGL_NONE};
+
+    egl_surface_ = eglCreateWindowSurface(egl_display_, egl_config, window_, attribs);
+
+    if (egl_surface_ == EGL_NO_SURFACE) {
+      LogLastEGLError();
+      FLWAY_ERR << "EGL surface was null during surface selection."
+                  << std::endl;
+      return false;
+    }
+  }
+
+  // Opaque lets the compositor skip blending and occlusion work below us,
+  // and put the surface on an overlay plane.
+  const SurfaceRect whole = {0, 0, static_cast<int32_t>(screen_width_),
+                             static_cast<int32_t>(screen_height_)};
+  if (!options_.translucent) {
+    opaque_region_.push_back(whole);
   }
+  input_region_.push_back(whole);
+  ApplySurfaceRegions();
 
   wl_surface_commit(compositor_surface_);
 
@@ -437,6 +1567,20 @@ bool WaylandDisplay::SetupEGL() {
 		return EIO;
 	}
 
+  // Stored with the surface, which is current here.
+  int swap_interval = options_.swap_interval;
+  if (swap_interval == 0 && !options_.vsync) {
+    FLWAY_ERR << "Swap interval 0 needs vsync to throttle frames, using 1."
+              << std::endl;
+    swap_interval = 1;
+  }
+  // Tearing is applied on the raster thread with the first frame.
+  swap_interval_ = swap_interval;
+  if (eglSwapInterval(egl_display_, swap_interval) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERR << "Could not set the swap interval." << std::endl;
+  }
+
 	gl_renderer_ = (char*) glGetString(GL_RENDERER);
 
 	gl_exts_ = (char*) glGetString(GL_EXTENSIONS);
@@ -448,12 +1592,36 @@ bool WaylandDisplay::SetupEGL() {
 	LOG_INFO("  extensions: \"%s\"\n", gl_exts_);
 	LOG_INFO("===================================\n");
 
+  gpu_timer_.reset(new GpuTimer(gl_exts_));
+  if (!gpu_timer_->IsValid()) {
+    gpu_timer_.reset();
+    LOG_INFO("No GL_EXT_disjoint_timer_query, GPU render time is not "
+             "measured\n");
+  }
+
 	eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 	if ((egl_error = eglGetError()) != EGL_SUCCESS) {
 		LOG_ERROR(stderr, "Could not clear OpenGL ES context. eglMakeCurrent: 0x%08X\n", egl_error);
 		return EIO;
 	}
 
+  if (options_.swap_thread) {
+    // The raster thread keeps its context current without the surface
+    // while the swap thread has it, and the swap thread must not swap
+    // before the frame's commands are done.
+    if (!egl_extensions ||
+        !HasExtension(egl_extensions, "EGL_KHR_surfaceless_context")) {
+      FLWAY_ERR << "No EGL_KHR_surfaceless_context, swapping on the raster "
+                   "thread." << std::endl;
+    } else if (!egl_sync_.available()) {
+      FLWAY_ERR << "No EGL_KHR_fence_sync, swapping on the raster thread."
+                << std::endl;
+    } else {
+      swap_thread_.reset(new SwapThread(egl_display_, egl_surface_,
+                                        egl_root_context_, egl_sync_));
+    }
+  }
+
 
   return true;
 }
@@ -465,7 +1633,17 @@ void WaylandDisplay::AnnounceRegistryInterface(struct wl_registry* wl_registry,
   if (strcmp(interface_name, "wl_compositor") == 0) {
     LOG_INFO("  wl_compositor object found\n");
     compositor_ = static_cast<decltype(compositor_)>(
-        wl_registry_bind(wl_registry, name, &wl_compositor_interface, 1));
+        wl_registry_bind(wl_registry, name, &wl_compositor_interface,
+                         std::min(version, 4u)));
+    // wl_surface.damage_buffer needs version 4.
+    compositor_version_ = std::min(version, 4u);
+    return;
+  }
+
+  if (strcmp(interface_name, "wl_subcompositor") == 0) {
+    LOG_INFO("  wl_subcompositor object found\n");
+    subcompositor_ = static_cast<decltype(subcompositor_)>(
+        wl_registry_bind(wl_registry, name, &wl_subcompositor_interface, 1));
     return;
   }
 
@@ -478,8 +1656,30 @@ void WaylandDisplay::AnnounceRegistryInterface(struct wl_registry* wl_registry,
 
   if (strcmp(interface_name, "wl_output") == 0){
     LOG_INFO("  wl_output object found\n");
-    output_ = static_cast<decltype(output_)>(
-        wl_registry_bind(wl_registry, name, &wl_output_interface, version));
+    outputs_->Add(wl_registry, name, version);
+    return;
+  }
+
+  if (strcmp(interface_name, "wp_presentation") == 0) {
+    LOG_INFO("  wp_presentation object found\n");
+    presentation_ = static_cast<decltype(presentation_)>(
+        wl_registry_bind(wl_registry, name, &wp_presentation_interface, 1));
+    wp_presentation_add_listener(presentation_, &kPresentationListener, this);
+    return;
+  }
+
+  if (strcmp(interface_name, "wp_viewporter") == 0) {
+    LOG_INFO("  wp_viewporter object found\n");
+    viewporter_ = static_cast<decltype(viewporter_)>(
+        wl_registry_bind(wl_registry, name, &wp_viewporter_interface, 1));
+    return;
+  }
+
+  if (strcmp(interface_name, "wp_tearing_control_manager_v1") == 0) {
+    LOG_INFO("  wp_tearing_control_manager_v1 object found\n");
+    tearing_control_manager_ =
+        static_cast<decltype(tearing_control_manager_)>(wl_registry_bind(
+            wl_registry, name, &wp_tearing_control_manager_v1_interface, 1));
     return;
   }
 
@@ -487,6 +1687,10 @@ void WaylandDisplay::AnnounceRegistryInterface(struct wl_registry* wl_registry,
     LOG_INFO("  wl_seat object found\n");
     seat_ = static_cast<decltype(seat_)>(
         wl_registry_bind(wl_registry, name, &wl_seat_interface, version));
+    if (input_queue_) {
+      // wl_touch and wl_keyboard created from the seat inherit its queue.
+      wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(seat_), input_queue_);
+    }
     wl_seat_add_listener(seat_, &my_wl_seat_listener, this);
     return;
   }
@@ -495,17 +1699,80 @@ void WaylandDisplay::AnnounceRegistryInterface(struct wl_registry* wl_registry,
 
 void WaylandDisplay::UnannounceRegistryInterface(
     struct wl_registry* wl_registry,
-    uint32_t name) {}
+    uint32_t name) {
+  outputs_->Remove(name);
+}
+
+void WaylandDisplay::OnSurfaceEnterOutput(wl_output* output) {
+  surface_output_count_++;
+  UpdateVisibility();
+
+  outputs_->OnSurfaceEnter(output);
+}
+
+void WaylandDisplay::OnSurfaceLeaveOutput(wl_output* output) {
+  if (surface_output_count_ > 0) {
+    surface_output_count_--;
+  }
+  outputs_->OnSurfaceLeave(output);
+  UpdateVisibility();
+}
+
+void WaylandDisplay::NotifyDisplays() {
+  FlutterEngine engine = FlutterApplication::GetFlutterEngine();
+  if (!engine) {
+    // Run() reports the outputs known by then once the engine is up.
+    return;
+  }
+
+  const std::vector<FlutterEngineDisplay> displays = outputs_->Displays();
+  // With no display left the engine falls back to an unknown refresh rate
+  // instead of pacing by an output that is gone. Nothing to take back if it
+  // never heard of one.
+  if (displays.empty() && !displays_reported_) {
+    return;
+  }
+
+  // The engine only knows the startup update type, but takes it again
+  // whenever the set of displays or their modes change.
+  FlutterEngineResult result = FlutterEngineNotifyDisplayUpdate(
+      engine, kFlutterEngineDisplaysUpdateTypeStartup, displays.data(),
+      displays.size());
+  if (result != kSuccess) {
+    LOG_ERROR(stderr, "FlutterEngineNotifyDisplayUpdate failed: %s\n",
+              FLUTTER_RESULT_TO_STRING(result));
+    return;
+  }
+  displays_reported_ = !displays.empty();
+}
 
 // |flutter::FlutterApplication::RenderDelegate|
 bool WaylandDisplay::OnApplicationContextMakeCurrent() {
   // FLWAY_LOG << "Entering OnApplicationContextMakeCurrent" << std::endl;
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationContextMakeCurrent");
 
   if (!valid_) {
     FLWAY_ERR << "Invalid display." << std::endl;
     return false;
   }
 
+  WaitForSwap();
+
+  const bool frame_start = TakeFrameStart();
+  if (frame_start) {
+    raster_start_ = FlutterEngineGetCurrentTime();
+  }
+
+  // Between frames, so the next back buffer has the new size.
+  const uint64_t window_size = pending_window_size_.exchange(0);
+  if (window_size != 0) {
+    window_width_ = window_size >> 32;
+    window_height_ = window_size & 0xffffffff;
+    wl_egl_window_resize(window_, window_width_, window_height_, 0, 0);
+    // New buffers report age 0 anyway, the history is for the old size.
+    damage_history_.clear();
+  }
+
   if (eglMakeCurrent(egl_display_, egl_surface_, egl_surface_, egl_render_context_) !=
       EGL_TRUE) {
     LogLastEGLError();
@@ -513,6 +1780,11 @@ bool WaylandDisplay::OnApplicationContextMakeCurrent() {
     return false;
   }
 
+  ApplyTearing();
+  if (frame_start && gpu_timer_) {
+    gpu_timer_->Begin();
+  }
+
   // FLWAY_LOG << "eglMakeCurrent OK" << std::endl;
   return true;
 }
@@ -520,12 +1792,20 @@ bool WaylandDisplay::OnApplicationContextMakeCurrent() {
 // |flutter::FlutterApplication::RenderDelegate|
 bool WaylandDisplay::OnApplicationContextClearCurrent() {
   FLWAY_LOG << "Entering OnApplicationContextClearCurrent" << std::endl;
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationContextClearCurrent");
 
   if (!valid_) {
     FLWAY_ERR << "Invalid display." << std::endl;
     return false;
   }
 
+  // A frame interrupted here is not timed, its query would also count
+  // whatever runs until the context is back.
+  if (gpu_timer_) {
+    gpu_timer_->Drop();
+  }
+  raster_start_ = 0;
+
   if (eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
                      EGL_NO_CONTEXT) != EGL_TRUE) {
     LogLastEGLError();
@@ -538,25 +1818,332 @@ bool WaylandDisplay::OnApplicationContextClearCurrent() {
 
 // |flutter::FlutterApplication::RenderDelegate|
 bool WaylandDisplay::OnApplicationPresent() {
+  return Present(nullptr);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationPresentWithInfo(
+    const FlutterPresentInfo* info) {
+  return Present(info);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationCreateBackingStore(
+    const FlutterBackingStoreConfig* config,
+    FlutterBackingStore* backing_store) {
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationCreateBackingStore");
+  return layer_compositor_->CreateBackingStore(config, backing_store);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationCollectBackingStore(
+    const FlutterBackingStore* backing_store) {
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationCollectBackingStore");
+  return layer_compositor_->CollectBackingStore(backing_store);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationPresentLayers(const FlutterLayer** layers,
+                                                size_t layers_count) {
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationPresentLayers");
+  if (!valid_) {
+    FLWAY_ERR << "Invalid display." << std::endl;
+    return false;
+  }
+  // The subsurface commits must not overtake the last frame's.
+  WaitForSwap();
+  if (!layer_compositor_->PresentLayers(layers, layers_count, egl_surface_,
+                                        egl_render_context_, window_width_,
+                                        window_height_)) {
+    FLWAY_ERR << "Could not present all layers." << std::endl;
+  }
+  // Commits the main surface and with it the subsurfaces.
+  return Present(nullptr);
+}
+
+wl_surface* WaylandDisplay::PlatformViewSurface(
+    FlutterPlatformViewIdentifier id) {
+  return layer_compositor_ ? layer_compositor_->PlatformViewSurface(id)
+                           : nullptr;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+void WaylandDisplay::OnApplicationPopulateExistingDamage(
+    intptr_t fbo_id,
+    FlutterDamage* damage) {
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationPopulateExistingDamage");
+  WaitForSwap();
+  // Unknown contents, repaint everything.
+  existing_damage_ = {0, 0, static_cast<double>(window_width_),
+                      static_cast<double>(window_height_)};
+
+  // Age N: the buffer was last drawn N frames ago and misses the damage of
+  // the N - 1 frames since.
+  EGLint age = 0;
+  if (has_buffer_age_ &&
+      eglQuerySurface(egl_display_, egl_surface_, EGL_BUFFER_AGE_EXT, &age) ==
+          EGL_TRUE &&
+      age > 0 && static_cast<size_t>(age) <= damage_history_.size() + 1) {
+    existing_damage_ = {0, 0, 0, 0};
+    for (EGLint i = 0; i < age - 1; i++) {
+      existing_damage_ = UnionRect(existing_damage_, damage_history_[i]);
+    }
+  }
+
+  damage->num_rects = 1;
+  damage->damage = &existing_damage_;
+}
+
+bool WaylandDisplay::Present(const FlutterPresentInfo* info) {
   // FLWAY_LOG << "Entering OnApplicationPresent" << std::endl;
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationPresent");
+  if (ThreadChecker::assertions_enabled() &&
+      eglGetCurrentContext() != egl_render_context_) {
+    FLWAY_ERR << "Presenting without the onscreen context current."
+              << std::endl;
+    abort();
+  }
 
   if (!valid_) {
     FLWAY_ERR << "Invalid display." << std::endl;
     return false;
   }
 
-  if (eglSwapBuffers(egl_display_, egl_surface_) != EGL_TRUE) {
+  const uint64_t present_time = FlutterEngineGetCurrentTime();
+
+  // Committed by the swap below. The done event is dispatched on the
+  // platform thread, which owns the default queue. Requested with vsync off
+  // too, for the frame statistics.
+  PendingFrame* pending_frame = new PendingFrame(this);
+  pending_frame->timing.vsync_start = last_vsync_start_.load();
+  pending_frame->timing.vsync_target = last_vsync_target_.load();
+  pending_frame->timing.raster_start = raster_start_;
+  pending_frame->timing.input = last_vsync_input_.exchange(0);
+  pending_frame->timing.tearing = tearing_applied_;
+  pending_frame->timing.present = present_time;
+  raster_start_ = 0;
+  frame_start_events_ |= kFrameStartPresent;
+  wl_callback* frame_callback = wl_surface_frame(compositor_surface_);
+  wl_callback_add_listener(frame_callback, &kFrameListener, pending_frame);
+  if (frames_in_flight_++ == 0) {
+    oldest_frame_in_flight_ = present_time;
+  }
+
+  struct wp_presentation_feedback* feedback = nullptr;
+  if (presentation_) {
+    feedback = wp_presentation_feedback(presentation_, compositor_surface_);
+    wp_presentation_feedback_add_listener(
+        feedback, &kPresentationFeedbackListener,
+        new PendingPresentation{this, present_time});
+  }
+
+  // What changed since the last frame, in buffer pixels from the top left.
+  // Without damage info the whole buffer did.
+  const FlutterRect full = {0, 0, static_cast<double>(window_width_),
+                            static_cast<double>(window_height_)};
+  FlutterRect frame_damage = {0, 0, 0, 0};
+  if (info && info->frame_damage.num_rects > 0) {
+    for (size_t i = 0; i < info->frame_damage.num_rects; i++) {
+      frame_damage = UnionRect(frame_damage, info->frame_damage.damage[i]);
+    }
+    frame_damage = IntersectRect(frame_damage, full);
+  } else {
+    frame_damage = full;
+  }
+  const bool partial = frame_damage.left > 0 || frame_damage.top > 0 ||
+                       frame_damage.right < full.right ||
+                       frame_damage.bottom < full.bottom;
+
+  damage_history_.push_front(frame_damage);
+  if (damage_history_.size() > kDamageHistory) {
+    damage_history_.pop_back();
+  }
+  damage_stats_.frames++;
+  if (partial) {
+    damage_stats_.partial_frames++;
+  }
+  if (full.right > 0 && full.bottom > 0) {
+    damage_stats_.damaged_permille += static_cast<uint64_t>(
+        1000 * (frame_damage.right - frame_damage.left) *
+        (frame_damage.bottom - frame_damage.top) / (full.right * full.bottom));
+  }
+
+  // Rounded out to whole pixels.
+  const int32_t damage_x = static_cast<int32_t>(floor(frame_damage.left));
+  const int32_t damage_y = static_cast<int32_t>(floor(frame_damage.top));
+  const int32_t damage_width =
+      static_cast<int32_t>(ceil(frame_damage.right)) - damage_x;
+  const int32_t damage_height =
+      static_cast<int32_t>(ceil(frame_damage.bottom)) - damage_y;
+
+  // Mesa hands swap with damage rects to the compositor itself, not every
+  // vendor driver does. Damage accumulates until the swap commits, so
+  // repeating it is harmless.
+  if (partial && compositor_version_ >= 4) {
+    wl_surface_damage_buffer(compositor_surface_, damage_x, damage_y,
+                             damage_width, damage_height);
+  }
+
+  if (gpu_timer_) {
+    gpu_timer_->End();
+  }
+  InsertGpuFence(pending_frame);
+
+  SwapJob job;
+  job.frame = pending_frame;
+  job.callback = frame_callback;
+  job.feedback = feedback;
+  job.partial = partial && swap_buffers_with_damage_;
+  // EGL counts from the bottom left.
+  job.rect[0] = damage_x;
+  job.rect[1] = static_cast<EGLint>(window_height_) - damage_y - damage_height;
+  job.rect[2] = damage_width;
+  job.rect[3] = damage_height;
+
+  bool swapped = true;
+  const bool posted =
+      swap_thread_ &&
+      swap_thread_->Post(egl_render_context_, [this, job](bool current) {
+        if (current) {
+          SwapBuffers(job);
+        } else {
+          DiscardSwap(job);
+        }
+      });
+  if (!posted) {
+    swapped = SwapBuffers(job);
+  }
+
+  if (!swapped) {
+    damage_history_.clear();
+  }
+  std::lock_guard<std::mutex> lock(present_stats_mutex_);
+  present_blocking_.Record(FlutterEngineGetCurrentTime() - present_time);
+  return swapped;
+}
+
+bool WaylandDisplay::SwapBuffers(const SwapJob& job) {
+  EGLBoolean swapped;
+  if (job.partial) {
+    EGLint rect[4] = {job.rect[0], job.rect[1], job.rect[2], job.rect[3]};
+    swapped = swap_buffers_with_damage_(egl_display_, egl_surface_, rect, 1);
+  } else {
+    swapped = eglSwapBuffers(egl_display_, egl_surface_);
+  }
+
+  if (swapped != EGL_TRUE) {
     LogLastEGLError();
     FLWAY_ERR << "Could not swap the EGL buffer." << std::endl;
+    DiscardSwap(job);
+    return false;
+  }
+
+  // The frame callback may already be on its way; OnFrameDone() copes with
+  // seeing zero here.
+  job.frame->swap_done.store(FlutterEngineGetCurrentTime(),
+                             std::memory_order_release);
+  PendingFrame::Release(job.frame);
+  return true;
+}
+
+bool WaylandDisplay::SetTearing(bool enabled) {
+  if (enabled && (!tearing_control_ || !options_.vsync)) {
+    // Swap interval 0 without vsync would render as fast as the GPU can.
     return false;
   }
+  if (tearing_.exchange(enabled) != enabled) {
+    LOG_INFO("Presenting with %s\n", enabled ? "async flips" : "vsync");
+  }
+  return true;
+}
+
+void WaylandDisplay::ApplyTearing() {
+  const bool tearing = tearing_;
+  if (tearing == tearing_applied_) {
+    return;
+  }
+  tearing_applied_ = tearing;
+  // Double buffered, the frame's swap commits it.
+  wp_tearing_control_v1_set_presentation_hint(
+      tearing_control_, tearing ? WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC
+                                : WP_TEARING_CONTROL_V1_PRESENTATION_HINT_VSYNC);
+  if (eglSwapInterval(egl_display_, tearing ? 0 : swap_interval_) !=
+      EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERR << "Could not set the swap interval." << std::endl;
+  }
+}
+
+bool WaylandDisplay::TakeFrameStart() {
+  const unsigned needed =
+      kFrameStartPresent | (options_.vsync ? kFrameStartVsync : 0);
+  unsigned events = frame_start_events_.load();
+  // Retried if a baton comes in meanwhile.
+  while ((events & needed) == needed &&
+         !frame_start_events_.compare_exchange_weak(events, events & ~needed)) {
+  }
+  return (events & needed) == needed;
+}
 
+void WaylandDisplay::InsertGpuFence(PendingFrame* frame) {
+  if (!gpu_fences_) {
+    return;
+  }
+  frame->refs++;
+  const bool inserted = gpu_fences_->Insert([frame](uint64_t signalled) {
+    if (signalled) {
+      frame->gpu_done = signalled;
+    }
+    PendingFrame::Release(frame);
+  });
+  if (!inserted) {
+    PendingFrame::Release(frame);
+  }
+}
+
+bool WaylandDisplay::HoldForGpu() {
+  if (!GpuTooFarBehind()) {
+    return false;
+  }
+  // Released by the platform loop once enough fences signalled.
+  if (!vsync_held_for_gpu_) {
+    vsync_stats_.gpu_throttled++;
+  }
+  vsync_held_for_gpu_ = true;
   return true;
 }
 
+bool WaylandDisplay::GpuTooFarBehind() {
+  if (options_.gpu_max_frames_behind == 0) {
+    return false;
+  }
+  return gpu_fences_ &&
+         gpu_fences_->size() > options_.gpu_max_frames_behind;
+}
+
+void WaylandDisplay::DiscardSwap(const SwapJob& job) {
+  // Never committed, so it would never fire and hold vsync forever.
+  wl_callback_destroy(job.callback);
+  PendingFrame::Release(job.frame);
+  PendingFrame::Release(job.frame);
+  frames_in_flight_--;
+  if (job.feedback) {
+    delete static_cast<PendingPresentation*>(
+        wl_proxy_get_user_data(reinterpret_cast<wl_proxy*>(job.feedback)));
+    wp_presentation_feedback_destroy(job.feedback);
+  }
+}
+
+void WaylandDisplay::WaitForSwap() {
+  if (swap_thread_) {
+    swap_thread_->Wait();
+  }
+}
+
 // |flutter::FlutterApplication::RenderDelegate|
 uint32_t WaylandDisplay::OnApplicationGetOnscreenFBO() {
   FLWAY_LOG << "Entering OnApplicationGetOnscreenFBO" << std::endl;
+  FLWAY_CHECK_THREAD(render_thread_, "OnApplicationGetOnscreenFBO");
 
   if (!valid_) {
     FLWAY_ERR << "Invalid display." << std::endl;
@@ -568,6 +2155,7 @@ uint32_t WaylandDisplay::OnApplicationGetOnscreenFBO() {
 
 bool WaylandDisplay::OnApplicationMakeResourceCurrent() {
   FLWAY_LOG << "Entering OnApplicationMakeResourceCurrent" << std::endl;
+  FLWAY_CHECK_THREAD(resource_thread_, "OnApplicationMakeResourceCurrent");
 
   if (!valid_) {
     FLWAY_ERR << "Invalid display." << std::endl;
@@ -583,8 +2171,34 @@ bool WaylandDisplay::OnApplicationMakeResourceCurrent() {
   return true;
 }
 
+// Called by the engine from any of its threads.
 void WaylandDisplay::OnApplicationGetTaskrunner(FlutterTask task, uint64_t target_time) {
-  TaskRunner.push(std::make_pair(target_time, task));
+  platform_task_runner_.PostTask(task, target_time);
+}
+
+// Called by the engine from any of its threads.
+bool WaylandDisplay::OnApplicationRunsTasksOnCurrentThread() {
+  return platform_task_runner_.RunsTasksOnCurrentThread();
+}
+
+void WaylandDisplay::OnApplicationVsync(intptr_t baton) {
+  OnApplicationPostWork(WorkLane::kFrame, "vsync request",
+                        [this, baton]() { RequestVsync(baton); });
+}
+
+void WaylandDisplay::OnApplicationPostWork(WorkLane lane,
+                                           const char* label,
+                                           std::function<void()> work) {
+  WorkQueue* queue = &plugin_work_;
+  if (lane == WorkLane::kFrame) {
+    queue = &frame_work_;
+  } else if (lane != WorkLane::kPlugin) {
+    FLWAY_ERR << "No work queue for the " << WorkLaneName(lane)
+              << " lane, queueing " << label << " as plugin work" << std::endl;
+  }
+  if (queue->Post(label, std::move(work))) {
+    loop_.Wakeup();
+  }
 }
 
 }  // namespace flutter
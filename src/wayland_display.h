@@ -10,9 +10,13 @@
 #ifndef EMBEDDER_WAYLAND_DISPLAY_H_
 #define EMBEDDER_WAYLAND_DISPLAY_H_
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <queue>
+#include <thread>
+#include <vector>
 
 #include <EGL/egl.h>
 #define  EGL_EGLEXT_PROTOTYPES
@@ -21,11 +25,35 @@
 #define  GL_GLEXT_PROTOTYPES
 #include <GLES2/gl2ext.h>
 
+#include <time.h>
+
 #include <wayland-client.h>
 #include <wayland-egl.h>
 
+#include "presentation-time-client-protocol.h"
+#include "tearing-control-v1-client-protocol.h"
+#include "viewporter-client-protocol.h"
+
+#include "embedder_options.h"
+#include "event_loop.h"
 #include "flutter_application.h"
+#include "frame_rate_controller.h"
+#include "frame_stats.h"
+#include "gpu_fences.h"
+#include "gpu_timer.h"
+#include "histogram.h"
+#include "input_hook.h"
+#include "layer_compositor.h"
 #include "macros.h"
+#include "output_tracker.h"
+#include "render_scale_controller.h"
+#include "ring_buffer.h"
+#include "swap_thread.h"
+#include "task_runner.h"
+#include "thread_checker.h"
+#include "vblank_timeline.h"
+#include "watchdog.h"
+#include "work_queue.h"
 
 namespace flutter {
 
@@ -79,9 +107,18 @@ struct touch_event {
        struct touch_point points[10];
 };
 
+// Input decoded by the wayland listeners, waiting to be handed to the engine.
+struct input_record {
+       enum { kPointer, kKey } type;
+       FlutterPointerEvent pointer;
+       uint32_t key;
+       uint32_t key_state;
+       uint64_t queued_at;
+};
+
 class WaylandDisplay : public FlutterApplication::RenderDelegate {
  public:
-  WaylandDisplay(size_t width, size_t height);
+  WaylandDisplay(size_t width, size_t height, const EmbedderOptions& options);
 
   ~WaylandDisplay();
 
@@ -89,6 +126,19 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
 
   bool Run();
 
+  // Hooks the embedder's own channels, flutter_embedder/display, into
+  // |application|.
+  void RegisterPlatformMessageHandlers(FlutterApplication* application);
+
+  // Tells the engine the size it renders at, see |render_scale_|.
+  bool SendWindowMetrics();
+
+  // --compositor was asked for and the compositor can do it.
+  bool HasLayerCompositor() const { return layer_compositor_ != nullptr; }
+
+  // See LayerCompositor::PlatformViewSurface(). Null without --compositor.
+  wl_surface* PlatformViewSurface(FlutterPlatformViewIdentifier id);
+
   // For handling touch events
   static const struct wl_touch_listener wl_touch_listener;
   static const struct wl_seat_listener my_wl_seat_listener;
@@ -128,23 +178,6 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   static void wl_touch_frame(void* data, struct wl_touch* wl_touch);
 
 
-  static void display_handle_mode(void* data,
-                                  struct wl_output* wl_output,
-                                  uint32_t flags,
-                                  int width,
-                                  int height,
-                                  int refresh);
-  static void display_handle_geometry(void* data,
-                                      struct wl_output* wl_output,
-                                      int x,
-                                      int y,
-                                      int physical_width,
-                                      int physical_height,
-                                      int subpixel,
-                                      const char* make,
-                                      const char* model,
-                                      int transform);
-
   // keyboard events
   struct xkb_state* xkb_state;
   struct xkb_context* xkb_context;
@@ -180,16 +213,20 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   static const wl_shell_surface_listener kShellSurfaceListener;
   static const wl_surface_listener kSurfaceListener;
   static const wl_display_listener kDisplayListener;
-  static const struct wl_output_listener output_listener;
+  static const wl_callback_listener kFrameListener;
+  static const wp_presentation_listener kPresentationListener;
+  static const wp_presentation_feedback_listener
+      kPresentationFeedbackListener;
 
   bool valid_ = false;
+  const EmbedderOptions options_;
   const int screen_width_;
   const int screen_height_;
   wl_display* display_ = nullptr;
   wl_registry* registry_ = nullptr;
   wl_compositor* compositor_ = nullptr;
+  wl_subcompositor* subcompositor_ = nullptr;
   wl_shell* shell_ = nullptr;
-  wl_output * output_ = nullptr;
   wl_shell_surface* shell_surface_ = nullptr;
   wl_surface* compositor_surface_ = nullptr;
   wl_egl_window* window_ = nullptr;
@@ -198,9 +235,19 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   EGLContext egl_root_context_ = EGL_NO_CONTEXT;
   EGLContext egl_render_context_ = EGL_NO_CONTEXT;
   EGLContext egl_uploading_context_ = EGL_NO_CONTEXT;
+  // Copies layers into their surfaces, with --compositor.
+  EGLContext egl_layer_context_ = EGL_NO_CONTEXT;
+  std::unique_ptr<LayerCompositor> layer_compositor_;
   char *gl_renderer_;
   char *gl_exts_;
 
+  // platform thread reactor
+  EventLoop loop_;
+  bool wayland_readable_ = false;
+  // The last flush left requests behind, the display fd is watched for
+  // EPOLLOUT until one goes through.
+  bool wayland_flush_pending_ = false;
+
   // input handling
   wl_seat * seat_ = nullptr;
   struct xdg_surface *xdg_surface = nullptr;
@@ -214,20 +261,375 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   struct pointer_event pointer_event={0};
   struct touch_event touch_event={0};
 
-  class CompareFlutterTask {
-   public:
-    bool operator()(std::pair<uint64_t, FlutterTask> n1,
-                    std::pair<uint64_t, FlutterTask> n2) {
-      return n1.first > n2.first;
+  // Optional thread that reads the input objects' private event queue and
+  // hands decoded events to the platform thread.
+  wl_event_queue* input_queue_ = nullptr;
+  std::thread input_reader_;
+  std::atomic<bool> input_reader_running_;
+  int input_reader_stop_fd_ = -1;
+  RingBuffer<input_record, 256> input_records_;
+  std::atomic<uint64_t> input_records_dropped_;
+
+  TaskRunner platform_task_runner_;
+
+  // Closures posted to the platform loop. The input and engine lanes are
+  // fed by |input_records_| and |platform_task_runner_| only.
+  WorkQueue frame_work_;
+  WorkQueue plugin_work_;
+  LaneStats lane_stats_[kWorkLaneCount];
+
+  // Told when the platform loop blocks and wakes up, and what it runs.
+  Watchdog watchdog_;
+
+  // Vsync. A request from the engine is answered by the frame callback of
+  // the frame in flight, or right away on the vblank grid when the
+  // compositor has nothing of ours to show. Platform thread only, except
+  // |frames_in_flight_| which present bumps.
+  static constexpr uint64_t kGpuFencePollInterval = 1000000;
+  struct frame vsync_frame_ = {kFrameRendered, 0};
+  std::atomic<int> frames_in_flight_;
+  VblankTimeline vblanks_;
+  struct VsyncStats {
+    uint64_t requests = 0;
+    // Batons returned from a frame callback, and right away.
+    uint64_t from_frame_callback = 0;
+    uint64_t immediate = 0;
+    uint64_t held_while_hidden = 0;
+    // Frame callbacks that came too early for the frame rate cap.
+    uint64_t capped = 0;
+    // Batons held because the GPU was too far behind.
+    uint64_t gpu_throttled = 0;
+  };
+  VsyncStats vsync_stats_;
+
+  // Frame rate cap. A baton the cap holds back is returned one vsync
+  // interval before the vblank it is allowed to aim for, zero when none is.
+  FrameRateController frame_rate_;
+  uint64_t deferred_vsync_target_ = 0;
+
+  // Render scale. The EGL window is |render_width_| x |render_height_| and
+  // a wp_viewport stretches it over the full screen size. The engine gets
+  // the render size with a matching pixel ratio, so layout does not change,
+  // and input is scaled down to match. Platform thread only, except
+  // |pending_window_size_| (width << 32 | height, zero for none) which the
+  // raster thread applies to the EGL window before its next frame.
+  wp_viewporter* viewporter_ = nullptr;
+  wp_viewport* viewport_ = nullptr;
+  double render_scale_ = 1.0;
+  size_t render_width_ = 0;
+  size_t render_height_ = 0;
+  std::unique_ptr<RenderScaleController> render_scale_controller_;
+  std::atomic<uint64_t> pending_window_size_;
+  // First make current of the frame being rastered. Raster thread only.
+  uint64_t raster_start_ = 0;
+  // What happened since the last frame started, kFrameStart* bits. The
+  // first make current after a present and, with vsync, a baton starts the
+  // next frame. Not a baton alone: the next one may come while the last
+  // frame is still rastering, and the engine makes the context current
+  // again before presenting it. Nor a present alone: the engine also makes
+  // the context current between frames. Starts out as if the frame before
+  // the first one had been presented.
+  static constexpr unsigned kFrameStartVsync = 1 << 0;
+  static constexpr unsigned kFrameStartPresent = 1 << 1;
+  std::atomic<unsigned> frame_start_events_{kFrameStartPresent};
+
+  // Tearing. With wp_tearing_control_v1 the surface asks for async flips
+  // and swaps with interval 0: vsync still paces the frames, but neither
+  // the driver nor the compositor waits for a vblank to show one.
+  // |tearing_| is set on the platform thread, the raster thread applies it
+  // before its next frame and keeps |tearing_applied_|. |swap_interval_| is
+  // the interval without tearing.
+  wp_tearing_control_manager_v1* tearing_control_manager_ = nullptr;
+  wp_tearing_control_v1* tearing_control_ = nullptr;
+  int swap_interval_ = 1;
+  std::atomic<bool> tearing_{false};
+  bool tearing_applied_ = false;
+
+  // First input since the last baton, and the input the last baton
+  // answers, read by present. For input to frame done latency.
+  uint64_t pending_input_ = 0;
+  std::atomic<uint64_t> last_vsync_input_{0};
+
+  // Opaque and input regions, in surface coordinates. Both cover the whole
+  // surface unless the app is translucent, in which case it sets them
+  // through the display channel. Platform thread only.
+  struct SurfaceRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+  };
+  std::vector<SurfaceRect> opaque_region_;
+  std::vector<SurfaceRect> input_region_;
+
+  // Partial repaint. The frame damage of the last few frames, newest first,
+  // tells what a back buffer of a given EGL_EXT_buffer_age is missing.
+  // Raster thread only, except the counters.
+  static constexpr size_t kDamageHistory = 4;
+  uint32_t compositor_version_ = 0;
+  bool has_buffer_age_ = false;
+  PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swap_buffers_with_damage_ = nullptr;
+  size_t window_width_ = 0;
+  size_t window_height_ = 0;
+  std::deque<FlutterRect> damage_history_;
+  FlutterRect existing_damage_ = {};
+  struct DamageStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> partial_frames{0};
+    // Sum over frames of the damaged share of the buffer, in 1/1000.
+    std::atomic<uint64_t> damaged_permille{0};
+  };
+  DamageStats damage_stats_;
+
+  // Per frame timing, from the vsync baton to the compositor's frame
+  // callback. The record rides along as the callback's user data. Always on.
+  struct PendingFrame {
+    explicit PendingFrame(WaylandDisplay* display)
+        : display(display), swap_done(0), refs(2) {}
+
+    // Set by the platform thread when the frame's GPU fence signalled.
+    uint64_t gpu_done = 0;
+
+    WaylandDisplay* display;
+    FrameTiming timing;
+    // Written after the commit, so it races the frame callback.
+    std::atomic<uint64_t> swap_done;
+    // Held by the frame callback, by whoever swaps and by the GPU fence if
+    // there is one. The last one out deletes the record.
+    std::atomic<int> refs;
+
+    static void Release(PendingFrame* frame) {
+      if (frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete frame;
+      }
+    }
+  };
+  // The baton last returned, read by present on the raster thread.
+  std::atomic<uint64_t> last_vsync_start_;
+  std::atomic<uint64_t> last_vsync_target_;
+  FrameStats frame_stats_;
+
+  // One frame's swap, run on the raster thread or handed to the swap
+  // thread. |rect| is the frame damage in EGL's bottom left coordinates,
+  // only used when |partial|.
+  struct SwapJob {
+    PendingFrame* frame = nullptr;
+    wl_callback* callback = nullptr;
+    struct wp_presentation_feedback* feedback = nullptr;
+    bool partial = false;
+    EGLint rect[4] = {};
+  };
+
+  // Swaps with |egl_root_context_|. Null unless EmbedderOptions::swap_thread
+  // and the display has what it needs, the raster thread swaps then.
+  std::unique_ptr<SwapThread> swap_thread_;
+
+  // GPU completion. Present puts a fence behind each frame's commands, the
+  // platform loop polls them. Vsync is held while more than
+  // |options_.gpu_max_frames_behind| fences are outstanding, so the driver
+  // queue does not grow. Null without EGL_KHR_fence_sync.
+  EGLSyncFunctions egl_sync_;
+  std::unique_ptr<GpuFenceQueue> gpu_fences_;
+  // A baton is held for the GPU. Platform thread only.
+  bool vsync_held_for_gpu_ = false;
+
+  // GPU cost of each frame, from the make current that starts it to
+  // present. Null without GL_EXT_disjoint_timer_query. The results go to
+  // |frame_stats_| through |gpu_render_times_|, platform thread only.
+  std::unique_ptr<GpuTimer> gpu_timer_;
+  std::vector<uint64_t> gpu_render_times_;
+
+  // How long the raster thread is held up inside present. The swap thread
+  // keeps the time waiting for it before the next frame.
+  std::mutex present_stats_mutex_;
+  Histogram present_blocking_;
+
+  // Visibility, from wl_surface enter/leave and frame callback starvation.
+  // While hidden the engine is told it is paused and vsync batons are held.
+  // Platform thread only, except |oldest_frame_in_flight_| which present
+  // sets when it finds no frame in flight.
+  bool visible_ = true;
+  int surface_output_count_ = 0;
+  bool surface_entered_once_ = false;
+  bool frame_callbacks_starved_ = false;
+  std::atomic<uint64_t> oldest_frame_in_flight_;
+  uint64_t hidden_since_ = 0;
+  struct VisibilityStats {
+    uint64_t hidden = 0;
+    uint64_t hidden_ns = 0;
+  };
+  VisibilityStats visibility_stats_;
+
+  // Created before the registry is bound. Its displays are reported to the
+  // engine, and the output pacing the surface sets |vblanks_|' interval.
+  std::unique_ptr<OutputTracker> outputs_;
+  // The engine was last told about at least one display.
+  bool displays_reported_ = false;
+
+  // wp_presentation feedback, if the compositor offers it: when each frame
+  // actually reached the screen. Drives the vblank prediction handed to the
+  // engine. Platform thread only.
+  struct PendingPresentation {
+    WaylandDisplay* display;
+    // When present was called, engine clock.
+    uint64_t submitted;
+  };
+  wp_presentation* presentation_ = nullptr;
+  clockid_t presentation_clock_ = CLOCK_MONOTONIC;
+  struct PresentationStats {
+    uint64_t presented = 0;
+    uint64_t discarded = 0;
+    // Vblanks between the first one a frame could have made and the one it
+    // was shown on.
+    uint64_t missed_vblanks = 0;
+    uint64_t vsync = 0;
+    uint64_t hw_clock = 0;
+    uint64_t hw_completion = 0;
+    uint64_t zero_copy = 0;
+  };
+  PresentationStats presentation_stats_;
+  // From present to the frame being shown, in nanoseconds.
+  Histogram present_latency_;
+
+  // Wayland objects belong to the platform thread, the onscreen context to
+  // the thread the engine renders on and the uploading context to its IO
+  // thread. Only consulted by FLWAY_CHECK_THREAD.
+  ThreadChecker platform_thread_;
+  ThreadChecker render_thread_;
+  ThreadChecker resource_thread_;
+
+  struct PlatformLoopStats {
+    uint64_t tasks_run = 0;
+    // Loop iterations that stopped running tasks because the budget ran out.
+    uint64_t budget_exhausted = 0;
+    // Tasks that were already due when the budget ran out, last time and
+    // worst case.
+    size_t overdue_backlog = 0;
+    size_t max_overdue_backlog = 0;
+    // Task runs cut short because the input reader queued an event.
+    uint64_t input_preemptions = 0;
+  };
+  PlatformLoopStats loop_stats_;
+
+  // Platform task lateness against the target time, run time and queue
+  // depth, in nanoseconds and tasks. |task_histograms_| covers the whole run
+  // and is dumped on SIGUSR1, |interval_histograms_| is reset by every
+  // periodic summary line.
+  struct TaskHistograms {
+    Histogram lateness;
+    Histogram duration;
+    Histogram depth;
+
+    void Reset() {
+      lateness.Reset();
+      duration.Reset();
+      depth.Reset();
     }
   };
-  std::priority_queue<std::pair<uint64_t, FlutterTask>,
-                      std::vector<std::pair<uint64_t, FlutterTask>>,
-                      CompareFlutterTask> 
-                      TaskRunner;
+  TaskHistograms task_histograms_;
+  TaskHistograms interval_histograms_;
+  int stats_signal_fd_ = -1;
+  uint64_t next_stats_time_ = 0;
 
   bool SetupEGL();
 
+  bool DispatchWaylandEvents();
+
+  // wl_display_flush(), watching |wayland_fd| for EPOLLOUT while requests
+  // are left over.
+  void FlushWayland(int wayland_fd);
+
+  // Serves every lane once, highest priority first. Returns true if work is
+  // left over.
+  bool RunLanes();
+
+  bool RunExpiredTasks(uint64_t start, uint64_t deadline);
+
+  void LogLaneStats() const;
+
+  void RequestVsync(intptr_t baton);
+
+  void OnFrameDone(wl_callback* callback, PendingFrame* pending);
+
+  // Returns the pending baton to the engine aiming for the next vblank, or
+  // defers it when the frame rate cap wants a later one.
+  void StartFrame(uint64_t now);
+
+  // Returns a baton deferred by StartFrame() once its time has come.
+  void RunDeferredVsync(uint64_t now);
+
+  // Returns the pending baton to the engine.
+  void FireVsync(uint64_t frame_start, uint64_t frame_target);
+
+  // Lifts the idle frame rate.
+  void OnUserInput();
+
+  // Resizes the EGL window and tells the engine. Platform thread only.
+  void SetRenderScale(double scale);
+
+  // Hands |opaque_region_| and |input_region_| to the compositor. They take
+  // effect with the next commit.
+  void ApplySurfaceRegions();
+
+  // False if |value| is not a list of [x, y, width, height].
+  static bool ParseSurfaceRects(const EncodableValue& value,
+                                std::vector<SurfaceRect>* rects);
+
+  // Maps |event| from surface to render coordinates and sends it.
+  void SendPointerEvent(FlutterPointerEvent event);
+
+  void OnDisplayChannelMessage(const FlutterPlatformMessage* message);
+
+  void OnPresented(const PendingPresentation& pending,
+                   uint64_t presented,
+                   uint32_t refresh,
+                   uint64_t seq,
+                   uint32_t flags);
+
+  // Converts a presentation clock timestamp to the engine's clock.
+  uint64_t PresentationTimeToEngineTime(uint64_t sec, uint32_t nsec) const;
+
+  void LogPresentationStats() const;
+
+  void OnSurfaceEnterOutput(wl_output* output);
+
+  void OnSurfaceLeaveOutput(wl_output* output);
+
+  void UpdateVisibility();
+
+  void CheckFrameCallbackStarvation(uint64_t now);
+
+  // When CheckFrameCallbackStarvation() may next have news, zero for never.
+  uint64_t FrameCallbackStarvationDeadline() const;
+
+  static void SendLifecycleState(const char* state);
+
+  // Hands every output with a known mode to FlutterEngineNotifyDisplayUpdate,
+  // an empty list once the last of them is gone.
+  void NotifyDisplays();
+
+  void PrintTaskStatsSummary();
+
+  void DumpTaskStats() const;
+
+  bool StartInputReader();
+
+  void StopInputReader();
+
+  void RunInputReader();
+
+  // Called by the input listeners, on the reader thread if there is one.
+  // Stamps |event| with the time it was received, the protocol's
+  // millisecond timestamps have an unspecified base.
+  void DeliverPointerEvent(FlutterPointerEvent event);
+
+  void DeliverKeyEvent(uint32_t key, uint32_t state);
+
+  // Hands input queued by the reader thread to the engine.
+  void DeliverQueuedInput();
+
+  static void SendKeyEvent(uint32_t key, uint32_t state);
+
   void AnnounceRegistryInterface(struct wl_registry* wl_registry,
                                  uint32_t name,
                                  const char* interface,
@@ -247,6 +649,55 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   // |flutter::FlutterApplication::RenderDelegate|
   bool OnApplicationPresent() override;
 
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresentWithInfo(const FlutterPresentInfo* info) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationPopulateExistingDamage(intptr_t fbo_id,
+                                           FlutterDamage* damage) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCreateBackingStore(
+      const FlutterBackingStoreConfig* config,
+      FlutterBackingStore* backing_store) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCollectBackingStore(
+      const FlutterBackingStore* backing_store) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresentLayers(const FlutterLayer** layers,
+                                  size_t layers_count) override;
+
+  // Swaps, with |info|'s frame damage when there is any.
+  bool Present(const FlutterPresentInfo* info);
+
+  // eglSwapBuffers and its bookkeeping. Needs the surface current.
+  bool SwapBuffers(const SwapJob& job);
+
+  // Fences the commands of |frame| so far. Raster thread, context current.
+  void InsertGpuFence(PendingFrame* frame);
+
+  bool GpuTooFarBehind();
+
+  // Platform thread. Returns false if tearing is not available.
+  bool SetTearing(bool enabled);
+
+  // Raster thread, the surface current.
+  void ApplyTearing();
+
+  // Consumes |frame_start_events_| if they start a frame. Raster thread.
+  bool TakeFrameStart();
+
+  // Returns true and keeps the baton if the GPU is too far behind.
+  bool HoldForGpu();
+
+  // Undoes the frame callback and feedback of a swap that never happened.
+  void DiscardSwap(const SwapJob& job);
+
+  // Blocks the raster thread until the swap thread is done with the surface.
+  void WaitForSwap();
+
   // |flutter::FlutterApplication::RenderDelegate|
   uint32_t OnApplicationGetOnscreenFBO() override;
 
@@ -255,6 +706,17 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
 
   void OnApplicationGetTaskrunner(FlutterTask task, uint64_t target_time) override;
 
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationRunsTasksOnCurrentThread() override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationPostWork(WorkLane lane,
+                             const char* label,
+                             std::function<void()> work) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationVsync(intptr_t baton) override;
+
   FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandDisplay);
 
   static void handle_wl_seat_capabilities(void *data, struct wl_seat *wl_seat, uint32_t capabilities);
@@ -0,0 +1,75 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "work_queue.h"
+
+#include <flutter_embedder.h>
+
+#include "watchdog.h"
+
+namespace flutter {
+
+const char* WorkLaneName(WorkLane lane) {
+  switch (lane) {
+    case WorkLane::kInput:
+      return "input";
+    case WorkLane::kFrame:
+      return "frame";
+    case WorkLane::kEngine:
+      return "engine";
+    case WorkLane::kPlugin:
+      return "plugin";
+  }
+  return "unknown";
+}
+
+WorkQueue::WorkQueue() = default;
+
+WorkQueue::~WorkQueue() = default;
+
+bool WorkQueue::Post(const char* label, Closure closure) {
+  Item item = {label, std::move(closure), FlutterEngineGetCurrentTime()};
+  std::lock_guard<std::mutex> lock(mutex_);
+  items_.push_back(std::move(item));
+  return items_.size() == 1;
+}
+
+bool WorkQueue::Run(uint64_t deadline, LaneStats* stats, Watchdog* watchdog) {
+  while (true) {
+    Item item;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (items_.empty()) {
+        return false;
+      }
+      stats->RecordDepth(items_.size());
+      item = std::move(items_.front());
+      items_.pop_front();
+    }
+
+    // The closure runs unlocked, it may well post more work.
+    const uint64_t now = FlutterEngineGetCurrentTime();
+    stats->Record(now - item.queued_at);
+    if (watchdog) {
+      watchdog->SetActivity(item.label);
+    }
+    item.closure();
+
+    if (deadline != 0 && FlutterEngineGetCurrentTime() >= deadline) {
+      return !empty();
+    }
+  }
+}
+
+bool WorkQueue::empty() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return items_.empty();
+}
+
+}  // namespace flutter
@@ -0,0 +1,112 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_WORK_QUEUE_H_
+#define EMBEDDER_FLUTTER_WORK_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "macros.h"
+
+namespace flutter {
+
+class Watchdog;
+
+// Priority classes of the platform loop, highest first. Every iteration
+// serves them in this order, so a flood in a lower class can delay but never
+// starve a higher one. Only frame and plugin work is posted as closures to a
+// WorkQueue; input and engine tasks come through queues of their own, the
+// input ring buffer and the platform TaskRunner, and share the lane for
+// ordering and stats.
+enum class WorkLane {
+  // Pointer and key events.
+  kInput,
+  // Vsync and frame scheduling.
+  kFrame,
+  // Tasks posted to the platform task runner by the engine.
+  kEngine,
+  // Platform channel handlers and plugins.
+  kPlugin,
+};
+
+constexpr size_t kWorkLaneCount = static_cast<size_t>(WorkLane::kPlugin) + 1;
+
+const char* WorkLaneName(WorkLane lane);
+
+// Latency bookkeeping of one lane. |wait| is the time from an item being
+// queued, or from its target time for engine tasks, to it being run.
+struct LaneStats {
+  uint64_t runs = 0;
+  uint64_t total_wait_ns = 0;
+  uint64_t max_wait_ns = 0;
+  size_t max_depth = 0;
+
+  void Record(uint64_t wait_ns) {
+    runs++;
+    total_wait_ns += wait_ns;
+    if (wait_ns > max_wait_ns) {
+      max_wait_ns = wait_ns;
+    }
+  }
+
+  void RecordDepth(size_t depth) {
+    if (depth > max_depth) {
+      max_depth = depth;
+    }
+  }
+
+  uint64_t average_wait_ns() const { return runs ? total_wait_ns / runs : 0; }
+};
+
+// FIFO of closures for one lane of the platform loop. Posting is thread
+// safe; running is reserved for the platform thread.
+class WorkQueue {
+ public:
+  using Closure = std::function<void()>;
+
+  WorkQueue();
+
+  ~WorkQueue();
+
+  // Thread safe. Returns true if the queue was empty, in which case the
+  // caller has to wake the platform loop. |label| names the work for the
+  // stall watchdog and has to outlive the queue.
+  bool Post(const char* label, Closure closure);
+
+  // Runs queued closures, oldest first, until the queue is empty or
+  // |deadline| has passed. At least one closure runs per call, so the lane
+  // makes progress even when higher lanes used up the time. A zero
+  // |deadline| means no limit. |watchdog| may be null. Returns true if
+  // closures are left.
+  bool Run(uint64_t deadline, LaneStats* stats, Watchdog* watchdog);
+
+  // Thread safe.
+  bool empty() const;
+
+ private:
+  struct Item {
+    const char* label;
+    Closure closure;
+    uint64_t queued_at;
+  };
+
+  mutable std::mutex mutex_;
+  std::deque<Item> items_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(WorkQueue);
+};
+
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_WORK_QUEUE_H_
@@ -0,0 +1,149 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "backing_store_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+// 100x100 at 4 bytes a pixel.
+constexpr size_t kStoreBytes = 100 * 100 * 4;
+
+// Hands out framebuffer names instead of GL objects and remembers which
+// ones were deleted.
+class BackingStorePoolTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<BackingStorePool> MakePool(size_t budget_bytes) {
+    return std::unique_ptr<BackingStorePool>(new BackingStorePool(
+        budget_bytes,
+        [this](PooledBackingStore* store) {
+          if (fail_creation_) {
+            return false;
+          }
+          store->framebuffer = ++created_;
+          return true;
+        },
+        [this](const PooledBackingStore& store) {
+          deleted_.push_back(store.framebuffer);
+        }));
+  }
+
+  uint32_t created_ = 0;
+  std::vector<uint32_t> deleted_;
+  bool fail_creation_ = false;
+};
+
+}  // namespace
+
+TEST_F(BackingStorePoolTest, ReleasedStoreIsReused) {
+  auto pool = MakePool(10 * kStoreBytes);
+  PooledBackingStore* store = pool->Acquire(100, 100, 1);
+  ASSERT_NE(store, nullptr);
+  EXPECT_EQ(created_, 1u);
+  pool->Release(store);
+
+  EXPECT_EQ(pool->Acquire(100, 100, 1), store);
+  EXPECT_EQ(created_, 1u);
+  EXPECT_TRUE(deleted_.empty());
+  pool->Release(store);
+}
+
+TEST_F(BackingStorePoolTest, SizeAndFormatMustMatch) {
+  auto pool = MakePool(10 * kStoreBytes);
+  PooledBackingStore* store = pool->Acquire(100, 100, 1);
+  pool->Release(store);
+
+  PooledBackingStore* other_format = pool->Acquire(100, 100, 2);
+  PooledBackingStore* other_size = pool->Acquire(100, 50, 1);
+  EXPECT_NE(other_format, store);
+  EXPECT_NE(other_size, store);
+  EXPECT_EQ(created_, 3u);
+  EXPECT_EQ(other_format->format, 2u);
+  EXPECT_EQ(other_size->height, 50u);
+  pool->Release(other_format);
+  pool->Release(other_size);
+}
+
+TEST_F(BackingStorePoolTest, LeastRecentlyReleasedIsEvictedFirst) {
+  // Room for three stores.
+  auto pool = MakePool(3 * kStoreBytes);
+  PooledBackingStore* first = pool->Acquire(100, 100, 1);
+  PooledBackingStore* second = pool->Acquire(100, 100, 2);
+  PooledBackingStore* third = pool->Acquire(100, 100, 3);
+  pool->Release(first);
+  pool->Release(second);
+  pool->Release(third);
+  EXPECT_TRUE(deleted_.empty());
+
+  // A fourth one goes over the budget, the oldest free store makes room.
+  PooledBackingStore* fourth = pool->Acquire(100, 100, 4);
+  EXPECT_EQ(deleted_, (std::vector<uint32_t>{1}));
+
+  // The others are still there.
+  EXPECT_EQ(pool->Acquire(100, 100, 2), second);
+  EXPECT_EQ(pool->Acquire(100, 100, 3), third);
+  EXPECT_EQ(created_, 4u);
+  pool->Release(second);
+  pool->Release(third);
+  pool->Release(fourth);
+}
+
+TEST_F(BackingStorePoolTest, StoresInUseAreNeverEvicted) {
+  auto pool = MakePool(2 * kStoreBytes);
+  std::vector<PooledBackingStore*> in_use;
+  for (uint32_t format = 0; format < 4; format++) {
+    PooledBackingStore* store = pool->Acquire(100, 100, format);
+    ASSERT_NE(store, nullptr);
+    in_use.push_back(store);
+  }
+  // Over the budget, but nothing is free to evict.
+  EXPECT_TRUE(deleted_.empty());
+
+  // Every release while over the budget is evicted right away until the
+  // pool fits again.
+  pool->Release(in_use[0]);
+  pool->Release(in_use[1]);
+  EXPECT_EQ(deleted_, (std::vector<uint32_t>{1, 2}));
+  pool->Release(in_use[2]);
+  pool->Release(in_use[3]);
+  EXPECT_EQ(deleted_, (std::vector<uint32_t>{1, 2}));
+}
+
+TEST_F(BackingStorePoolTest, ZeroBudgetKeepsNothing) {
+  auto pool = MakePool(0);
+  PooledBackingStore* store = pool->Acquire(100, 100, 1);
+  pool->Release(store);
+  EXPECT_EQ(deleted_, (std::vector<uint32_t>{1}));
+  store = pool->Acquire(100, 100, 1);
+  EXPECT_EQ(created_, 2u);
+  pool->Release(store);
+}
+
+TEST_F(BackingStorePoolTest, FailedCreationReturnsNull) {
+  auto pool = MakePool(10 * kStoreBytes);
+  fail_creation_ = true;
+  EXPECT_EQ(pool->Acquire(100, 100, 1), nullptr);
+  fail_creation_ = false;
+
+  // Nothing was counted against the budget for it.
+  PooledBackingStore* store = pool->Acquire(100, 100, 1);
+  ASSERT_NE(store, nullptr);
+  pool->Release(store);
+  EXPECT_TRUE(deleted_.empty());
+}
+
+}  // namespace testing
+}  // namespace flutter
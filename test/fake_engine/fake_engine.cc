@@ -0,0 +1,30 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "fake_engine.h"
+
+#include <atomic>
+
+#include <flutter_embedder.h>
+
+namespace flutter {
+namespace testing {
+
+static std::atomic<uint64_t> fake_engine_time(1000000000000ull);
+
+void SetFakeEngineTime(uint64_t now) {
+  fake_engine_time = now;
+}
+
+}  // namespace testing
+}  // namespace flutter
+
+uint64_t FlutterEngineGetCurrentTime() {
+  return flutter::testing::fake_engine_time;
+}
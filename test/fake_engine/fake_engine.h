@@ -0,0 +1,25 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FAKE_ENGINE_H_
+#define EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FAKE_ENGINE_H_
+
+#include <stdint.h>
+
+namespace flutter {
+namespace testing {
+
+// What FlutterEngineGetCurrentTime() returns, in nanoseconds. Starts well
+// away from zero, which the embedder treats as "no time".
+void SetFakeEngineTime(uint64_t now);
+
+}  // namespace testing
+}  // namespace flutter
+
+#endif  // EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FAKE_ENGINE_H_
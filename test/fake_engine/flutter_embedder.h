@@ -0,0 +1,36 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Stands in for the engine's flutter_embedder.h in the unit tests, with just
+// the declarations the code under test uses. The clock is a fake the tests
+// move by hand, see fake_engine.h.
+
+#ifndef EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FLUTTER_EMBEDDER_H_
+#define EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FLUTTER_EMBEDDER_H_
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct _FlutterTaskRunner* FlutterTaskRunner;
+
+typedef struct {
+  FlutterTaskRunner runner;
+  uint64_t task;
+} FlutterTask;
+
+uint64_t FlutterEngineGetCurrentTime();
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // EMBEDDER_FLUTTER_TEST_FAKE_ENGINE_FLUTTER_EMBEDDER_H_
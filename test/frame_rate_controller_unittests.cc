@@ -0,0 +1,106 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_rate_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+// 60 Hz.
+constexpr uint64_t kVsync = 16666667;
+
+}  // namespace
+
+TEST(FrameRateControllerTest, CapIsAWholeNumberOfVblanks) {
+  FrameRateController controller(30, 0, 0);
+  EXPECT_EQ(controller.FrameInterval(kVsync), 2 * kVsync);
+
+  controller.SetMaxFrameRate(15);
+  EXPECT_EQ(controller.FrameInterval(kVsync), 4 * kVsync);
+
+  // 35 fps on 60 Hz rounds to every other vblank.
+  controller.SetMaxFrameRate(35);
+  EXPECT_EQ(controller.FrameInterval(kVsync), 2 * kVsync);
+
+  // 45 fps on 60 Hz too, every vblank would be 60 fps and break the cap.
+  controller.SetMaxFrameRate(45);
+  EXPECT_EQ(controller.FrameInterval(kVsync), 2 * kVsync);
+}
+
+TEST(FrameRateControllerTest, CapIsNeverExceeded) {
+  // 10 fps on 144 Hz: 14.4 vblanks, rounded up to 15 for 9.6 fps.
+  const uint64_t vsync_144 = 6944444;
+  FrameRateController controller(10, 0, 0);
+  EXPECT_EQ(controller.FrameInterval(vsync_144), 15 * vsync_144);
+}
+
+TEST(FrameRateControllerTest, NativeRateIsEveryVblank) {
+  FrameRateController controller(0, 0, 0);
+  EXPECT_EQ(controller.FrameInterval(kVsync), kVsync);
+
+  // 60 fps on a 59.94 Hz panel still means every vblank.
+  controller.SetMaxFrameRate(60);
+  EXPECT_EQ(controller.FrameInterval(16683350), 16683350u);
+
+  // A cap above the refresh rate cannot go faster than it.
+  controller.SetMaxFrameRate(144);
+  EXPECT_EQ(controller.FrameInterval(kVsync), kVsync);
+}
+
+TEST(FrameRateControllerTest, GoesIdleWithoutInputAndBackOnInput) {
+  FrameRateController controller(0, 10, 3);
+  EXPECT_FALSE(controller.OnFrame());
+  EXPECT_FALSE(controller.OnFrame());
+  EXPECT_TRUE(controller.OnFrame());
+  EXPECT_TRUE(controller.idle());
+  EXPECT_EQ(controller.frame_rate(), 10u);
+  EXPECT_EQ(controller.FrameInterval(kVsync), 6 * kVsync);
+  // Entering idle is reported once.
+  EXPECT_FALSE(controller.OnFrame());
+
+  EXPECT_TRUE(controller.OnInput());
+  EXPECT_FALSE(controller.idle());
+  EXPECT_EQ(controller.frame_rate(), 0u);
+  EXPECT_FALSE(controller.OnInput());
+}
+
+TEST(FrameRateControllerTest, InputRestartsTheIdleCount) {
+  FrameRateController controller(0, 10, 3);
+  controller.OnFrame();
+  controller.OnFrame();
+  controller.OnInput();
+  EXPECT_FALSE(controller.OnFrame());
+  EXPECT_FALSE(controller.OnFrame());
+  EXPECT_TRUE(controller.OnFrame());
+}
+
+TEST(FrameRateControllerTest, IdleNeverRaisesTheCap) {
+  FrameRateController controller(5, 10, 1);
+  EXPECT_TRUE(controller.OnFrame());
+  EXPECT_EQ(controller.frame_rate(), 5u);
+}
+
+TEST(FrameRateControllerTest, ZeroIdleAfterFramesTurnsIdleOff) {
+  FrameRateController controller(0, 10, 0);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_FALSE(controller.OnFrame());
+  }
+  EXPECT_FALSE(controller.idle());
+
+  controller.SetIdleFrameRate(10, 2);
+  EXPECT_FALSE(controller.OnFrame());
+  EXPECT_TRUE(controller.OnFrame());
+}
+
+}  // namespace testing
+}  // namespace flutter
@@ -0,0 +1,96 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+TEST(HistogramTest, EmptyHistogramReportsZero) {
+  Histogram histogram;
+  EXPECT_EQ(histogram.count(), 0u);
+  EXPECT_EQ(histogram.min(), 0u);
+  EXPECT_EQ(histogram.max(), 0u);
+  EXPECT_EQ(histogram.mean(), 0u);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 0u);
+}
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  Histogram histogram;
+  for (uint64_t value = 0; value < 32; value++) {
+    histogram.Record(value);
+  }
+  EXPECT_EQ(histogram.count(), 32u);
+  EXPECT_EQ(histogram.min(), 0u);
+  EXPECT_EQ(histogram.max(), 31u);
+  EXPECT_EQ(histogram.mean(), 15u);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 15u);
+  EXPECT_EQ(histogram.ValueAtPercentile(100), 31u);
+}
+
+TEST(HistogramTest, PercentilesAreWithinASixteenthAboveTheExactValue) {
+  std::mt19937_64 random(1);
+  for (int round = 0; round < 20; round++) {
+    std::unique_ptr<Histogram> histogram(new Histogram());
+    std::vector<uint64_t> values;
+    const size_t count = 1 + random() % 5000;
+    for (size_t i = 0; i < count; i++) {
+      const uint64_t value = random() >> (random() % 64);
+      values.push_back(value);
+      histogram->Record(value);
+    }
+    std::sort(values.begin(), values.end());
+
+    for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9, 100.0}) {
+      uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+      rank = std::max<uint64_t>(rank, 1);
+      const uint64_t exact = values[rank - 1];
+      const uint64_t reported = histogram->ValueAtPercentile(percentile);
+      EXPECT_GE(reported, exact) << percentile;
+      EXPECT_LE(reported - exact, exact / 16 + 1) << percentile;
+    }
+    EXPECT_EQ(histogram->min(), values.front());
+    EXPECT_EQ(histogram->max(), values.back());
+  }
+}
+
+TEST(HistogramTest, LargestValueFits) {
+  Histogram histogram;
+  histogram.Record(UINT64_MAX);
+  EXPECT_EQ(histogram.max(), UINT64_MAX);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), UINT64_MAX);
+}
+
+TEST(HistogramTest, MergeAddsUp) {
+  Histogram a;
+  Histogram b;
+  a.Record(10);
+  a.Record(20);
+  b.Record(5);
+  b.Record(1000);
+  a.Merge(b);
+  EXPECT_EQ(a.count(), 4u);
+  EXPECT_EQ(a.min(), 5u);
+  EXPECT_EQ(a.max(), 1000u);
+  EXPECT_EQ(a.mean(), (10u + 20u + 5u + 1000u) / 4);
+
+  a.Reset();
+  EXPECT_EQ(a.count(), 0u);
+  EXPECT_EQ(a.max(), 0u);
+}
+
+}  // namespace testing
+}  // namespace flutter
@@ -0,0 +1,93 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "render_scale_controller.h"
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+constexpr uint64_t kBudget = 16666667;
+
+// Feeds one decision window of frames taking |render_time| each. Returns
+// how many of them changed the scale.
+int RecordWindow(RenderScaleController* controller, uint64_t render_time) {
+  int changes = 0;
+  for (size_t i = 0; i < RenderScaleController::kWindow; i++) {
+    changes += controller->Record(render_time, kBudget);
+  }
+  return changes;
+}
+
+}  // namespace
+
+TEST(RenderScaleControllerTest, StartsAtTheMaximum) {
+  RenderScaleController controller(0.5, 1.0);
+  EXPECT_DOUBLE_EQ(controller.scale(), 1.0);
+}
+
+TEST(RenderScaleControllerTest, DecidesOncePerWindow) {
+  RenderScaleController controller(0.5, 1.0);
+  for (size_t i = 0; i + 1 < RenderScaleController::kWindow; i++) {
+    EXPECT_FALSE(controller.Record(kBudget * 2, kBudget));
+  }
+  EXPECT_TRUE(controller.Record(kBudget * 2, kBudget));
+  EXPECT_NEAR(controller.scale(), 0.9, 1e-9);
+}
+
+TEST(RenderScaleControllerTest, SlowWindowsStepDownToTheMinimum) {
+  RenderScaleController controller(0.5, 1.0);
+  for (int window = 0; window < 10; window++) {
+    RecordWindow(&controller, kBudget * 95 / 100);
+  }
+  EXPECT_NEAR(controller.scale(), 0.5, 1e-9);
+  EXPECT_EQ(RecordWindow(&controller, kBudget * 2), 0);
+}
+
+TEST(RenderScaleControllerTest, TwoFastWindowsInARowStepUp) {
+  RenderScaleController controller(0.5, 1.0);
+  RecordWindow(&controller, kBudget * 2);
+  RecordWindow(&controller, kBudget * 2);
+  EXPECT_NEAR(controller.scale(), 0.8, 1e-9);
+
+  EXPECT_EQ(RecordWindow(&controller, kBudget / 2), 0);
+  EXPECT_EQ(RecordWindow(&controller, kBudget / 2), 1);
+  EXPECT_NEAR(controller.scale(), 0.9, 1e-9);
+}
+
+TEST(RenderScaleControllerTest, InBetweenWindowsHoldTheScale) {
+  RenderScaleController controller(0.5, 1.0);
+  RecordWindow(&controller, kBudget * 2);
+  EXPECT_EQ(RecordWindow(&controller, kBudget / 2), 0);
+  // Neither slow nor fast, resets the run of fast windows.
+  EXPECT_EQ(RecordWindow(&controller, kBudget * 3 / 4), 0);
+  EXPECT_EQ(RecordWindow(&controller, kBudget / 2), 0);
+  EXPECT_NEAR(controller.scale(), 0.9, 1e-9);
+}
+
+TEST(RenderScaleControllerTest, ASingleHiccupDoesNotCostResolution) {
+  RenderScaleController controller(0.5, 1.0);
+  controller.Record(kBudget * 10, kBudget);
+  EXPECT_EQ(RecordWindow(&controller, kBudget / 2), 0);
+  EXPECT_DOUBLE_EQ(controller.scale(), 1.0);
+}
+
+TEST(RenderScaleControllerTest, ZeroBudgetIsIgnored) {
+  RenderScaleController controller(0.5, 1.0);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_FALSE(controller.Record(kBudget, 0));
+  }
+  EXPECT_DOUBLE_EQ(controller.scale(), 1.0);
+}
+
+}  // namespace testing
+}  // namespace flutter
@@ -0,0 +1,95 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ring_buffer.h"
+
+#include <stdint.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+TEST(RingBufferTest, PopsInPushOrder) {
+  RingBuffer<int, 4> buffer;
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_TRUE(buffer.Push(1));
+  EXPECT_TRUE(buffer.Push(2));
+  EXPECT_FALSE(buffer.empty());
+
+  int item = 0;
+  ASSERT_TRUE(buffer.Pop(&item));
+  EXPECT_EQ(item, 1);
+  ASSERT_TRUE(buffer.Pop(&item));
+  EXPECT_EQ(item, 2);
+  EXPECT_FALSE(buffer.Pop(&item));
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, RefusesPushesWhenFull) {
+  RingBuffer<int, 4> buffer;
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(buffer.Push(i));
+  }
+  EXPECT_FALSE(buffer.Push(4));
+
+  int item = 0;
+  ASSERT_TRUE(buffer.Pop(&item));
+  EXPECT_EQ(item, 0);
+  EXPECT_TRUE(buffer.Push(4));
+}
+
+TEST(RingBufferTest, WrapsAround) {
+  RingBuffer<int, 4> buffer;
+  int item = 0;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(buffer.Push(i));
+    ASSERT_TRUE(buffer.Push(i + 1000));
+    ASSERT_TRUE(buffer.Pop(&item));
+    EXPECT_EQ(item, i);
+    ASSERT_TRUE(buffer.Pop(&item));
+    EXPECT_EQ(item, i + 1000);
+  }
+  EXPECT_TRUE(buffer.empty());
+}
+
+// The reader thread pushes while the platform thread pops.
+TEST(RingBufferTest, OneProducerOneConsumer) {
+  constexpr uint64_t kItems = 200000;
+  RingBuffer<uint64_t, 64> buffer;
+
+  std::thread producer([&buffer]() {
+    for (uint64_t i = 0; i < kItems; i++) {
+      while (!buffer.Push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint64_t expected = 0;
+  bool in_order = true;
+  while (expected < kItems) {
+    uint64_t item;
+    if (!buffer.Pop(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    in_order = in_order && item == expected;
+    expected++;
+  }
+  producer.join();
+
+  EXPECT_TRUE(in_order);
+  EXPECT_TRUE(buffer.empty());
+}
+
+}  // namespace testing
+}  // namespace flutter
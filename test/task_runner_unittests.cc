@@ -0,0 +1,162 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "task_runner.h"
+
+#include <poll.h>
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_engine.h"
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+constexpr uint64_t kStart = 1000000000000ull;
+constexpr uint64_t kMinute = 60000000000ull;
+
+FlutterTask MakeTask(uint64_t id) {
+  return FlutterTask{nullptr, id};
+}
+
+class TaskRunnerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SetFakeEngineTime(kStart);
+    runner_.BindToCurrentThread();
+  }
+
+  // Pops every task due at |now|, returning their ids in order.
+  std::vector<uint64_t> PopAll(uint64_t now) {
+    std::vector<uint64_t> ids;
+    FlutterTask task;
+    while (runner_.PopExpiredTask(now, &task, nullptr)) {
+      ids.push_back(task.task);
+    }
+    return ids;
+  }
+
+  TaskRunner runner_;
+};
+
+}  // namespace
+
+TEST_F(TaskRunnerTest, PostingSignalsTheWakeupFdOnce) {
+  pollfd fd = {runner_.wakeup_fd(), POLLIN, 0};
+  EXPECT_EQ(poll(&fd, 1, 0), 0);
+
+  runner_.PostTask(MakeTask(1), kStart);
+  runner_.PostTask(MakeTask(2), kStart);
+  ASSERT_EQ(poll(&fd, 1, 0), 1);
+
+  runner_.DrainPostedTasks();
+  EXPECT_EQ(poll(&fd, 1, 0), 0);
+  EXPECT_EQ(PopAll(kStart), (std::vector<uint64_t>{1, 2}));
+}
+
+TEST_F(TaskRunnerTest, TasksWithTheSameTargetRunInPostingOrder) {
+  for (uint64_t i = 0; i < 10; i++) {
+    runner_.PostTask(MakeTask(i), kStart + 1000000);
+  }
+  runner_.DrainPostedTasks();
+  EXPECT_EQ(PopAll(kStart + 2000000),
+            (std::vector<uint64_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+// Several engine threads post at once while the owner drains. Every task
+// arrives exactly once, and each producer's tasks in the order it posted.
+TEST_F(TaskRunnerTest, ConcurrentProducersLoseNothing) {
+  constexpr uint64_t kProducers = 4;
+  constexpr uint64_t kTasksPerProducer = 20000;
+
+  std::vector<std::thread> producers;
+  for (uint64_t producer = 0; producer < kProducers; producer++) {
+    producers.emplace_back([this, producer]() {
+      for (uint64_t i = 0; i < kTasksPerProducer; i++) {
+        runner_.PostTask(MakeTask(producer << 32 | i), kStart);
+      }
+    });
+  }
+
+  std::vector<uint64_t> next(kProducers, 0);
+  uint64_t received = 0;
+  bool in_order = true;
+  while (received < kProducers * kTasksPerProducer) {
+    pollfd fd = {runner_.wakeup_fd(), POLLIN, 0};
+    poll(&fd, 1, 1000);
+    runner_.DrainPostedTasks();
+    FlutterTask task;
+    while (runner_.PopExpiredTask(kStart, &task, nullptr)) {
+      const uint64_t producer = task.task >> 32;
+      const uint64_t index = task.task & 0xffffffff;
+      if (producer >= kProducers) {
+        ADD_FAILURE() << "Unknown task " << task.task;
+        continue;
+      }
+      in_order = in_order && index == next[producer];
+      next[producer] = index + 1;
+      received++;
+    }
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(received, kProducers * kTasksPerProducer);
+  runner_.DrainPostedTasks();
+  EXPECT_EQ(runner_.size(), 0u);
+}
+
+TEST_F(TaskRunnerTest, FarTaskComesBeforeLaterWheelTask) {
+  // Beyond the wheel's range when posted, so it goes to the heap.
+  const uint64_t far_target = kStart + 30 * kMinute;
+  runner_.PostTask(MakeTask(1), far_target);
+  runner_.DrainPostedTasks();
+
+  // Close enough by now for the wheel, but due after the heap task.
+  SetFakeEngineTime(kStart + 25 * kMinute);
+  runner_.PostTask(MakeTask(2), far_target + 1000000);
+  runner_.DrainPostedTasks();
+
+  EXPECT_EQ(runner_.NextDeadline(), far_target);
+  EXPECT_EQ(PopAll(far_target + kMinute), (std::vector<uint64_t>{1, 2}));
+  EXPECT_EQ(runner_.size(), 0u);
+}
+
+TEST_F(TaskRunnerTest, WheelTaskComesBeforeLaterFarTask) {
+  const uint64_t far_target = kStart + 30 * kMinute;
+  runner_.PostTask(MakeTask(1), far_target);
+  runner_.DrainPostedTasks();
+
+  SetFakeEngineTime(kStart + 25 * kMinute);
+  runner_.PostTask(MakeTask(2), far_target - 1000000);
+  runner_.DrainPostedTasks();
+
+  EXPECT_EQ(PopAll(far_target + kMinute), (std::vector<uint64_t>{2, 1}));
+}
+
+TEST_F(TaskRunnerTest, NothingIsPoppedEarly) {
+  runner_.PostTask(MakeTask(1), kStart + 5000000);
+  runner_.PostTask(MakeTask(2), kStart + 40 * kMinute);
+  runner_.DrainPostedTasks();
+
+  EXPECT_TRUE(PopAll(kStart + 4000000).empty());
+  EXPECT_EQ(PopAll(kStart + 6000000), (std::vector<uint64_t>{1}));
+  EXPECT_TRUE(PopAll(kStart + 39 * kMinute).empty());
+  EXPECT_EQ(PopAll(kStart + 40 * kMinute), (std::vector<uint64_t>{2}));
+}
+
+}  // namespace testing
+}  // namespace flutter
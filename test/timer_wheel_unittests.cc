@@ -0,0 +1,172 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+constexpr uint64_t kTick = 1ull << TimerWheel::kTickShift;
+constexpr uint64_t kStart = 1000 * kTick;
+
+FlutterTask MakeTask(uint64_t id) {
+  return FlutterTask{nullptr, id};
+}
+
+// Pops every task due at |now|, returning their ids in order.
+std::vector<uint64_t> PopAll(TimerWheel* wheel, uint64_t now) {
+  std::vector<uint64_t> ids;
+  FlutterTask task;
+  while (wheel->PopExpired(now, &task, nullptr)) {
+    ids.push_back(task.task);
+  }
+  return ids;
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, EmptyWheelHasNoDeadline) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  EXPECT_EQ(wheel.NextDeadline(), 0u);
+  EXPECT_EQ(wheel.size(), 0u);
+  EXPECT_TRUE(PopAll(&wheel, kStart + 1000 * kTick).empty());
+}
+
+TEST(TimerWheelTest, OverdueTaskIsDueRightAway) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  ASSERT_TRUE(wheel.Insert(MakeTask(1), kStart - 5 * kTick));
+  ASSERT_TRUE(wheel.Insert(MakeTask(2), kStart));
+  EXPECT_EQ(wheel.NextDeadline(), 1u);
+  EXPECT_EQ(wheel.expired_count(), 2u);
+  EXPECT_EQ(PopAll(&wheel, kStart), (std::vector<uint64_t>{1, 2}));
+}
+
+TEST(TimerWheelTest, NeverExpiresEarlyAndAtMostOneTickLate) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  const uint64_t target = kStart + 10 * kTick + 123;
+  ASSERT_TRUE(wheel.Insert(MakeTask(7), target));
+
+  EXPECT_TRUE(PopAll(&wheel, target - 1).empty());
+  EXPECT_EQ(wheel.size(), 1u);
+
+  uint64_t target_time = 0;
+  FlutterTask task;
+  ASSERT_TRUE(wheel.PopExpired(target + kTick, &task, &target_time));
+  EXPECT_EQ(task.task, 7u);
+  EXPECT_EQ(target_time, target);
+  EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheelTest, NextDeadlineIsTheEarliestTaskRoundedUpToItsTick) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  const uint64_t near = kStart + 3 * kTick + 1;
+  ASSERT_TRUE(wheel.Insert(MakeTask(1), kStart + 200 * kTick));
+  ASSERT_TRUE(wheel.Insert(MakeTask(2), near));
+  // On a higher level, further out.
+  ASSERT_TRUE(wheel.Insert(MakeTask(3), kStart + 5000 * kTick));
+
+  const uint64_t deadline = wheel.NextDeadline();
+  EXPECT_GE(deadline, near);
+  EXPECT_LT(deadline, near + kTick);
+}
+
+TEST(TimerWheelTest, SameTickKeepsInsertionOrder) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  const uint64_t tick_start = kStart + 20 * kTick;
+  ASSERT_TRUE(wheel.Insert(MakeTask(1), tick_start + 300));
+  ASSERT_TRUE(wheel.Insert(MakeTask(2), tick_start + 100));
+  ASSERT_TRUE(wheel.Insert(MakeTask(3), tick_start + 200));
+  EXPECT_EQ(PopAll(&wheel, tick_start + kTick),
+            (std::vector<uint64_t>{1, 2, 3}));
+}
+
+TEST(TimerWheelTest, TasksCascadeFromHigherLevels) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  // One task per level: within 256 ticks, within 256^2, within 256^3.
+  const uint64_t targets[] = {
+      kStart + 100 * kTick,
+      kStart + 40000 * kTick + 17,
+      kStart + 9000000 * kTick + 5,
+  };
+  for (uint64_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(wheel.Insert(MakeTask(i), targets[i]));
+  }
+
+  // Walk time forward in uneven steps and check every task comes out on
+  // its tick, in order, no matter how many boundaries a step crosses.
+  std::vector<uint64_t> seen;
+  uint64_t now = kStart;
+  while (wheel.size() != 0) {
+    const uint64_t deadline = wheel.NextDeadline();
+    ASSERT_NE(deadline, 0u);
+    now = std::max(now, deadline);
+    FlutterTask task;
+    uint64_t target_time;
+    while (wheel.PopExpired(now, &task, &target_time)) {
+      EXPECT_EQ(target_time, targets[task.task]);
+      EXPECT_LE(target_time, now);
+      EXPECT_LT(now - target_time, kTick);
+      seen.push_back(task.task);
+    }
+    now += 777 * kTick;
+  }
+  EXPECT_EQ(seen, (std::vector<uint64_t>{0, 1, 2}));
+}
+
+TEST(TimerWheelTest, LargeJumpExpiresEverything) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  for (uint64_t i = 0; i < 100; i++) {
+    ASSERT_TRUE(wheel.Insert(MakeTask(i), kStart + (i * i * 997 + 1) * kTick));
+  }
+  const std::vector<uint64_t> ids = PopAll(&wheel, kStart + 20000000 * kTick);
+  ASSERT_EQ(ids.size(), 100u);
+  for (uint64_t i = 0; i < ids.size(); i++) {
+    EXPECT_EQ(ids[i], i);
+  }
+}
+
+TEST(TimerWheelTest, RefusesTasksBeyondItsRange) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  const uint64_t range = 1ull << (TimerWheel::kLevels * TimerWheel::kSlotBits);
+  EXPECT_FALSE(wheel.Insert(MakeTask(1), kStart + (range + 2) * kTick));
+  EXPECT_FALSE(wheel.Insert(MakeTask(2), UINT64_MAX));
+  EXPECT_EQ(wheel.size(), 0u);
+  EXPECT_TRUE(wheel.Insert(MakeTask(3), kStart + (range - 2) * kTick));
+}
+
+TEST(TimerWheelTest, PeekDoesNotPop) {
+  TimerWheel wheel;
+  wheel.Advance(kStart);
+  ASSERT_TRUE(wheel.Insert(MakeTask(1), kStart + 2 * kTick));
+
+  uint64_t target_time = 0;
+  EXPECT_FALSE(wheel.PeekExpired(kStart, &target_time));
+  ASSERT_TRUE(wheel.PeekExpired(kStart + 3 * kTick, &target_time));
+  EXPECT_EQ(target_time, kStart + 2 * kTick);
+  EXPECT_EQ(wheel.size(), 1u);
+  EXPECT_EQ(PopAll(&wheel, kStart + 3 * kTick), (std::vector<uint64_t>{1}));
+}
+
+}  // namespace testing
+}  // namespace flutter
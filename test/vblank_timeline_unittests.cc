@@ -0,0 +1,83 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+/*
+ *  Copyright (C) 2020-2021 XCVMByte Ltd.
+ *  All Rights Reserved.
+ *
+ */
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vblank_timeline.h"
+
+#include <gtest/gtest.h>
+
+namespace flutter {
+namespace testing {
+
+namespace {
+
+constexpr uint64_t kInterval = 10000000;
+constexpr uint64_t kStart = 1000 * kInterval;
+
+}  // namespace
+
+TEST(VblankTimelineTest, WithoutAnchorIsOneIntervalOut) {
+  VblankTimeline vblanks;
+  EXPECT_EQ(vblanks.interval(), VblankTimeline::kDefaultInterval);
+  EXPECT_EQ(vblanks.NextVblank(kStart), kStart + vblanks.interval());
+}
+
+TEST(VblankTimelineTest, RefreshRateSetsTheInterval) {
+  VblankTimeline vblanks;
+  vblanks.SetRefreshRate(100000);
+  EXPECT_EQ(vblanks.interval(), kInterval);
+  // Unknown rates are ignored.
+  vblanks.SetRefreshRate(0);
+  EXPECT_EQ(vblanks.interval(), kInterval);
+}
+
+TEST(VblankTimelineTest, SnapsToTheFrameCallbackGrid) {
+  VblankTimeline vblanks;
+  vblanks.SetRefreshRate(100000);
+  vblanks.OnFrameDone(kStart);
+  EXPECT_EQ(vblanks.NextVblank(kStart - 5), kStart);
+  EXPECT_EQ(vblanks.NextVblank(kStart), kStart + kInterval);
+  EXPECT_EQ(vblanks.NextVblank(kStart + 3 * kInterval + 1),
+            kStart + 4 * kInterval);
+}
+
+TEST(VblankTimelineTest, PresentationFeedbackWinsOverFrameCallbacks) {
+  VblankTimeline vblanks;
+  vblanks.OnFrameDone(kStart + 1234);
+  vblanks.OnPresented(kStart - kInterval, kStart, kInterval, 0, false);
+  EXPECT_EQ(vblanks.interval(), kInterval);
+  EXPECT_EQ(vblanks.NextVblank(kStart + 1), kStart + kInterval);
+}
+
+TEST(VblankTimelineTest, CountsMissedVblanksByTime) {
+  VblankTimeline vblanks;
+  EXPECT_EQ(vblanks.OnPresented(kStart - kInterval, kStart, kInterval, 0,
+                                false),
+            0u);
+  // Made the next vblank.
+  EXPECT_EQ(vblanks.OnPresented(kStart + 1, kStart + kInterval, kInterval, 0,
+                                false),
+            0u);
+  // Submitted in time for the next one, shown two later.
+  const uint64_t last = kStart + kInterval;
+  EXPECT_EQ(vblanks.OnPresented(last + 1, last + 3 * kInterval, kInterval, 0,
+                                false),
+            2u);
+}
+
+TEST(VblankTimelineTest, CountsMissedVblanksBySequence) {
+  VblankTimeline vblanks;
+  vblanks.OnPresented(kStart - kInterval, kStart, kInterval, 100, true);
+  // The timestamp jittered, the counter says one vblank was missed.
+  EXPECT_EQ(vblanks.OnPresented(kStart + 1, kStart + 2 * kInterval + 900,
+                                kInterval, 102, true),
+            1u);
+}
+
+}  // namespace testing
+}  // namespace flutter